@@ -0,0 +1,133 @@
+#pragma once
+#include <juce_core/juce_core.h>
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include "SampleLibrary.h"
+#include "Slicer.h"
+#include "WaveformCache.h"
+
+// What a finished load worked out about a file, kept on disk so reopening it (in a later
+// session too) skips the overview scan, the FFT pass and the content hash: the waveform
+// is whole and the slices are placed before the audio has decoded.
+// One sidecar per file in the user's application data folder, named after the file's
+// path and checked against its path, size and modification time. The format is versioned
+// (anything else is a miss) and laid out to be read straight from a memory map: a fixed
+// header, then the path, the waveform bins (min, max per bin, level by level), the novelty
+// curve and the onsets, all 4-byte aligned, native byte order.
+// Loader thread only.
+class AnalysisCache {
+public:
+    static constexpr juce::uint32 formatVersion = 1;
+    static constexpr juce::int64 defaultBudgetBytes = (juce::int64) 256 << 20;
+    struct Record {
+        juce::String hash; // SampleLibrary content hash
+        int firstLevel { 0 }; std::array<std::vector<WaveformCache::Bin>, WaveformCache::numLevels> levels;
+        NoveltyCurve novelty;
+        SampleLibrary::OnsetKey onsetKey; std::vector<SlicePoint> onsets;
+    };
+
+    explicit AnalysisCache (juce::File dir = defaultDirectory(), juce::int64 budget = defaultBudgetBytes)
+        : directory (std::move (dir)), budgetBytes (budget) {}
+    static juce::File defaultDirectory() {
+        return juce::File::getSpecialLocation (juce::File::userApplicationDataDirectory).getChildFile ("Noob_Tools").getChildFile ("AnalysisCache");
+    }
+    // The record saved for 'file' as it is now, or nullptr (none, stale, other version, damaged).
+    std::unique_ptr<Record> load (const juce::File& file) const {
+        juce::MemoryMappedFile map (sidecarFor (file), juce::MemoryMappedFile::readOnly);
+        const auto* base = static_cast<const char*> (map.getData());
+        const auto size = map.getSize();
+        Header h {};
+        if (base == nullptr || size < sizeof (Header)) return {};
+        std::memcpy (&h, base, sizeof (Header));
+        if (std::memcmp (h.magic, magic, sizeof (h.magic)) != 0 || h.version != formatVersion
+            || h.fileSize != file.getSize() || h.modified != file.getLastModificationTime().toMilliseconds()
+            || h.firstLevel < 0 || h.firstLevel >= WaveformCache::numLevels || h.pathBytes < 0
+            || h.noveltyValues < 0 || h.numOnsets < 0 || h.hash[sizeof (h.hash) - 1] != 0)
+            return {};
+        size_t needed = sizeof (Header) + padded ((size_t) h.pathBytes) + (size_t) h.noveltyValues * sizeof (float) + (size_t) h.numOnsets * sizeof (juce::int32);
+        for (auto n : h.levelBins) { if (n < 0) return {}; needed += (size_t) n * 2 * sizeof (float); }
+        if (size < needed) return {};
+        const char* p = base + sizeof (Header);
+        if (juce::String::fromUTF8 (p, h.pathBytes) != file.getFullPathName()) return {};
+        p += padded ((size_t) h.pathBytes);
+        auto r = std::make_unique<Record>();
+        r->hash = juce::String (h.hash);
+        r->firstLevel = h.firstLevel;
+        for (int l = 0; l < WaveformCache::numLevels; ++l) {
+            auto& bins = r->levels[(size_t) l]; bins.resize ((size_t) h.levelBins[l]);
+            for (auto& b : bins) { float v[2]; std::memcpy (v, p, sizeof (v)); p += sizeof (v); b = { v[0], v[1] }; }
+        }
+        auto& nc = r->novelty;
+        nc.values.resize ((size_t) h.noveltyValues);
+        std::memcpy (nc.values.data(), p, nc.values.size() * sizeof (float)); p += nc.values.size() * sizeof (float);
+        nc.fftOrder = h.fftOrder; nc.hopSize = h.hopSize; nc.channel = h.noveltyChannel; nc.numSamples = h.noveltySamples;
+        r->onsetKey = { h.sensitivity, h.median != 0, h.maxSlices, h.onsetLength };
+        r->onsets.resize ((size_t) h.numOnsets);
+        for (auto& o : r->onsets) { juce::int32 v; std::memcpy (&v, p, sizeof (v)); p += sizeof (v); o.sampleIndex = v; }
+        sidecarFor (file).setLastModificationTime (juce::Time::getCurrentTime()); // trim() drops the least recently used
+        return r;
+    }
+    // Writes the record for 'file' (replacing any older one in one step), then trims the
+    // folder to its budget, least recently used sidecars first.
+    bool save (const juce::File& file, const Record& r) const {
+        if (r.hash.isEmpty() || (size_t) r.hash.getNumBytesAsUTF8() >= sizeof (Header::hash) || ! directory.createDirectory()) return false;
+        Header h {};
+        std::memcpy (h.magic, magic, sizeof (h.magic)); h.version = formatVersion;
+        h.fileSize = file.getSize(); h.modified = file.getLastModificationTime().toMilliseconds();
+        r.hash.copyToUTF8 (h.hash, sizeof (h.hash));
+        h.firstLevel = r.firstLevel;
+        for (int l = 0; l < WaveformCache::numLevels; ++l) h.levelBins[l] = (juce::int32) r.levels[(size_t) l].size();
+        h.fftOrder = r.novelty.fftOrder; h.hopSize = r.novelty.hopSize; h.noveltyChannel = r.novelty.channel;
+        h.noveltyValues = (juce::int32) r.novelty.values.size(); h.noveltySamples = r.novelty.numSamples;
+        h.sensitivity = r.onsetKey.sensitivity; h.median = r.onsetKey.median ? 1 : 0; h.maxSlices = r.onsetKey.maxSlices;
+        h.numOnsets = (juce::int32) r.onsets.size(); h.onsetLength = r.onsetKey.length;
+        const auto path = file.getFullPathName().toStdString();
+        h.pathBytes = (juce::int32) path.size();
+
+        const auto target = sidecarFor (file);
+        juce::TemporaryFile temp (target);
+        {
+            juce::FileOutputStream out (temp.getFile());
+            if (! out.openedOk()) return false;
+            out.write (&h, sizeof (Header));
+            out.write (path.data(), path.size());
+            const char zeros[4] {}; out.write (zeros, padded (path.size()) - path.size());
+            for (auto& level : r.levels)
+                for (auto& b : level) { const float v[2] { b.first, b.second }; out.write (v, sizeof (v)); }
+            out.write (r.novelty.values.data(), r.novelty.values.size() * sizeof (float));
+            for (auto& o : r.onsets) { const juce::int32 v = o.sampleIndex; out.write (&v, sizeof (v)); }
+            out.flush();
+            if (out.getStatus().failed()) return false;
+        }
+        if (! temp.overwriteTargetFileWithTemporary()) return false;
+        trim (target);
+        return true;
+    }
+private:
+    struct Header {
+        char magic[4]; juce::uint32 version;
+        juce::int64 fileSize, modified;
+        char hash[32];
+        juce::int32 firstLevel, levelBins[WaveformCache::numLevels];
+        juce::int32 fftOrder, hopSize, noveltyChannel, noveltyValues; juce::int64 noveltySamples;
+        float sensitivity; juce::int32 median, maxSlices, numOnsets; juce::int64 onsetLength;
+        juce::int32 pathBytes, reserved { 0 };
+    };
+    static_assert (sizeof (Header) == 136 && sizeof (Header) % 8 == 0, "sidecar header layout changed: bump formatVersion");
+    static constexpr char magic[4] { 'N', 'T', 'A', 'C' };
+    static size_t padded (size_t bytes) { return (bytes + 3) & ~(size_t) 3; }
+    juce::File sidecarFor (const juce::File& file) const {
+        return directory.getChildFile (juce::String::toHexString (file.getFullPathName().hashCode64()) + ".ntac");
+    }
+    void trim (const juce::File& keep) const {
+        auto files = directory.findChildFiles (juce::File::findFiles, false, "*.ntac");
+        std::sort (files.begin(), files.end(), [] (const juce::File& a, const juce::File& b) { return a.getLastModificationTime() > b.getLastModificationTime(); });
+        juce::int64 total = 0;
+        for (auto& f : files)
+            if ((total += f.getSize()) > budgetBytes && f != keep) f.deleteFile();
+    }
+    juce::File directory; juce::int64 budgetBytes;
+};
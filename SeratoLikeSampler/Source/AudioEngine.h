@@ -5,22 +5,176 @@
 #include <map>
 #include "PadVoice.h"
 #include "SamplePool.h"
+#include "AnalysisCache.h"
+#include "SampleLibrary.h"
 #include "Slicer.h"
+#include "SliceAnalysisWorker.h"
+#include "SliceRenderer.h"
+#include "SliceExporter.h"
+#include "RealtimeSnapshot.h"
+#include "RealtimeQueue.h"
+#include "RealtimeGuard.h"
+#include "VoiceAllocator.h"
 #include <atomic>
+#include <limits>
 #include <thread>
+// Immutable slice table as seen by the audio thread. Built and published by the
+// writer side (under dataLock) after every edit; never mutated once published.
+struct SliceTable {
+    SliceTable() { byNote.fill (nullptr); }
+    SliceTable (const SliceTable&) = delete;
+    SliceTable& operator= (const SliceTable&) = delete;
+    std::vector<PadSlice> slices;
+    std::map<int, float> gainByStart;
+    std::map<int, PadSlice> userSlices;
+    int baseNote { 36 };
+    std::array<const PadSlice*, 128> byNote; // resolved MIDI note -> slice (user slices take priority)
+    std::vector<std::shared_ptr<const SliceRender>> renders; // keeps the slices' 'rendered' alive
+    std::vector<std::shared_ptr<const SamplePool>> sources;  // and their 'source' files
+    void resolve() {
+        byNote.fill (nullptr);
+        for (size_t i = 0; i < slices.size(); ++i) {
+            const int note = baseNote + (int) i;
+            if (note >= 0 && note < 128) byNote[(size_t) note] = &slices[i];
+        }
+        for (const auto& kv : userSlices)
+            if (kv.first >= 0 && kv.first < 128) byNote[(size_t) kv.first] = &kv.second;
+    }
+};
+// A pad, transport or edit event for the audio thread. The UI posts these with a
+// timestamp; host MIDI is converted to the same form so render() handles both alike.
+struct EngineEvent {
+    enum class Type { noteOn, noteOff, previewToggle, previewStart, previewStop, previewSeek, loopPreview, loopRegion, tapSlice, userSlice };
+    Type type { Type::noteOn };
+    int note { 0 };             // noteOn, noteOff, userSlice
+    bool flag { false };        // loopPreview: enabled; userSlice: quantize to transient
+    float a { 0.f }, b { 0.f }; // previewSeek: position; loopRegion: start/end (normalised to the full length)
+    double timeMs { 0.0 };      // juce::Time::getMillisecondCounterHiRes() when posted
+    int offset { 0 };           // sample offset in the block being rendered
+};
 class AudioEngine {
 public:
-    void prepare (double sampleRate, int blockSize) {
-        sr = sampleRate; for (auto& v : voices) v.prepare (sampleRate, blockSize); slicer.prepare (sampleRate);
+    AudioEngine() {
+        analysis.start ([this] (const SliceAnalysisWorker::Controls& c) { applySliceControls (c); },
+                        [this] { return applySliceEdits(); });
+        renderer.start ([this] (const SliceRenderer::Key& k, juce::AudioBuffer<float>& dest) { return readForRender (k, dest); },
+                        [this] { const rt::ScopedWriterLock sl (dataLock); publishSlices(); });
+    }
+    ~AudioEngine() {
+        cancelLoad.store (true);
+        renderer.stop();
+        analysis.stop();
+        if (loader && loader->joinable()) loader->join();
+    }
+    // numVoices: polyphony (8..256); the bank adds a quarter again (at least 8) for fade-outs.
+    void prepare (double sampleRate, int blockSize, int numVoices = 32) {
+        sr = sampleRate; analysis.prepare (sampleRate); renderer.prepare (sampleRate);
+        {
+            // Host-rate playback copies (cached per rate) of what can sound right away: the
+            // current file and the pads' files. The rest of the library converts in
+            // makeCurrent(), on the loader, once it is switched back to.
+            const rt::ScopedWriterLock al (analysisLock);
+            const rt::ScopedWriterLock sl (dataLock);
+            bool changed = false;
+            std::vector<const SamplePool*> done;
+            const auto convert = [&] (const SamplePool* p) {
+                if (p == nullptr) p = &pool();
+                if (std::find (done.begin(), done.end(), p) != done.end()) return;
+                done.push_back (p);
+                if (auto* e = library.find (p)) changed = e->pool->setPlaybackRate (sampleRate) || changed;
+            };
+            convert (nullptr);
+            for (auto& s : slices) convert (s.source);
+            for (auto& kv : userSlices) convert (kv.second.source);
+            if (changed) {
+                previewPlayPos = pool().toPlayback (previewPos.load());
+                publishSlices();
+            }
+        }
+        polyphony = juce::jlimit (8, 256, numVoices);
+        voices.killAll(); // lets go of the files they play (voice counts) before the bank is rebuilt
+        voices.prepare (sampleRate, blockSize, polyphony + juce::jmax (8, polyphony / 4));
+        voiceAlloc.prepare (voices.size(), polyphony);
+        playing.resize ((size_t) voices.size());
+        for (int i = 0; i < SamplePool::maxPlayHeads; ++i) pool().setPlayHead (i, -1);
+        previewScratch.prepare (blockSize);
+        {
+            // Audio stopped: drop the bus stage; it is rebuilt for the new rate once wanted
+            const juce::ScopedLock bl (busBuildLock);
+            busBuilt.store (false); keyOnBus.store (false); busSemitones = 0.0f; busMix = 0.0f; busWarmup = 0;
+            bus.reset(); busLatency.store (0); busBlockSize = juce::jmax (1, blockSize);
+        }
+        buildMasterBus();
         // update min-gap in samples when sample rate changes
         setMinGapMs (minGapMs);
     }
+    // Output delay: the pads' and preview's (the selected backend's latency) plus the master
+    // bus stage (0 with the resampler). Any thread; follows the backend, so poll it.
+    int getLatencySamples() const { return voices.getLatency() + (keyOnBus.load() ? busLatency.load() : 0); }
     void setParams (float attack, float release, float cutoff, float reso, float gainDb) {
-        for (auto& v : voices) v.setParams (attack, release, cutoff, reso, gainDb);
+        voices.setParams (attack, release, cutoff, reso, gainDb);
     }
+    // A file already in the library becomes current straight away, with its waveform,
+    // analysis and slice edits. It is looked up by path, size and modification time, then by
+    // the content hash kept in its AnalysisCache sidecar; neither reads the audio. Otherwise
+    // it decodes in chunks without holding the engine locks: each chunk becomes playable
+    // (preview, pads) and drawable as soon as it lands. Once the first chunk is in, the
+    // content hash is worked out here and a copy of a file already in the library is folded
+    // into that entry. Slices are first built once firstSliceSeconds are decoded, rebuilt
+    // each time the decoded length doubles (linear total analysis cost) and once more when
+    // the file is complete. A file analysed in an earlier load has its whole waveform and
+    // slices straight away; only the audio is still decoding. User-mapped pads keep playing
+    // the files they were cut from.
     bool loadFile (const juce::File& f) {
-        const juce::ScopedLock sl (dataLock);
-        if (! pool.loadFromFile (f)) return false; buildSlices(); return true;
+        {
+            const rt::ScopedWriterLock al (analysisLock);
+            const rt::ScopedWriterLock sl (dataLock);
+            if (auto* e = library.find (f)) { makeCurrent (*e); library.evict (&pool()); return true; }
+        }
+        auto stored = analysisCache.load (f);
+        if (stored != nullptr) {
+            const rt::ScopedWriterLock al (analysisLock);
+            const rt::ScopedWriterLock sl (dataLock);
+            if (auto* e = library.find (stored->hash)) {
+                e->files.addIfNotAlreadyThere (SampleLibrary::fileId (f)); // a copy: found by path next time
+                makeCurrent (*e); library.evict (&pool()); return true;
+            }
+        }
+        auto next = std::make_shared<SamplePool>();
+        next->setPlaybackRate (sr);
+        if (! next->beginLoad (f, sampleStorage.load())) return false;
+        const bool restored = stored != nullptr && next->restoreAnalysis (stored->firstLevel, std::move (stored->levels), std::move (stored->novelty));
+        auto hash = stored != nullptr ? stored->hash : juce::String();
+        {
+            const rt::ScopedWriterLock al (analysisLock);
+            const rt::ScopedWriterLock sl (dataLock);
+            auto& e = library.add (hash, f, next);
+            if (restored && stored->onsetKey.length == next->getFullLengthInSamples()) { e.onsetKey = stored->onsetKey; e.onsets = std::move (stored->onsets); }
+            makeCurrent (e);
+        }
+        auto nextSliceAt = (juce::int64) (next->getSampleRate() * firstSliceSeconds);
+        bool hashed = stored != nullptr, merged = false;
+        while (! cancelLoad.load() && next->decodeNextChunk()) {
+            if (! hashed) {
+                // The first chunk is playable: now the full read for the content hash
+                hashed = true; hash = library.hashOf (f);
+                if ((merged = mergeDuplicate (f, *next, hash))) break;
+            }
+            if (next->isAnalysed() || next->getLengthInSamples() < nextSliceAt) continue;
+            sliceLoadedAudio();
+            nextSliceAt = next->getLengthInSamples() * 2;
+        }
+        if (! hashed && next->isFullyLoaded()) { hash = library.hashOf (f); merged = mergeDuplicate (f, *next, hash); }
+        if (! merged && next->isFullyLoaded()) {
+            if (! next->isAnalysed()) sliceLoadedAudio();
+            if (! restored) saveAnalysis (f, hash, *next);
+        }
+        next.reset(); // a merged duplicate can go in the evict() below
+        const rt::ScopedWriterLock al (analysisLock);
+        const rt::ScopedWriterLock sl (dataLock);
+        if (restored && ! merged) publishSlices(); // renders past the decoded audio were refused until now
+        library.evict (&pool());
+        return true;
     }
     bool loadFileAsync (const juce::File& f) {
         bool expected = false;
@@ -34,14 +188,12 @@ public:
         });
         return true;
     }
-    void setSliceControls (int newBaseNote, int newMaxSlices, float newSensitivity) {
+    // Realtime-safe: called from processBlock, re-slicing happens on the analysis worker
+    void setSliceControls (int newBaseNote, int newMaxSlices, float newSensitivity, bool newMedianThreshold = false) {
         newBaseNote   = juce::jlimit (0, 127, newBaseNote);
         newMaxSlices  = juce::jlimit (1, 128, newMaxSlices);
         newSensitivity = juce::jlimit (0.6f, 2.0f, newSensitivity);
-        if (baseNote != newBaseNote || maxSlices != newMaxSlices || std::abs (sensitivity - newSensitivity) > 1.0e-4f) {
-            pushSnapshot();
-            baseNote = newBaseNote; maxSlices = newMaxSlices; sensitivity = newSensitivity; buildSlices();
-        }
+        analysis.requestControls (newBaseNote, newMaxSlices, newSensitivity, newMedianThreshold);
     }
     void setMinGapMs (float ms) {
         minGapMs = juce::jlimit (1.0f, 500.0f, ms);
@@ -50,82 +202,71 @@ public:
     }
     void render (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midi) {
         buffer.clear();
-        if (loading.load()) return;
-        juce::ScopedTryLock tryLock (dataLock);
-        if (! tryLock.isLocked()) return;
-        // Preview playback of the long file
-        if (previewPlaying && pool.getBuffer().getNumSamples() > 0) {
-            const auto& src = pool.getBuffer();
-            const int total = src.getNumSamples();
-            const int loopStart = juce::jlimit (0, total, loopStartSample);
-            const int loopEnd   = juce::jlimit (loopStart, total, loopEndSample > 0 ? loopEndSample : total);
-            int remaining = total - previewPos;
-            int toCopy = juce::jmin (buffer.getNumSamples(), remaining);
-            if (toCopy > 0) {
-                for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
-                    buffer.addFrom (ch, 0, src, juce::jmin (ch, src.getNumChannels()-1), previewPos, toCopy, 0.5f);
-                previewPos += toCopy;
-            }
-            const int boundary = loopPreview ? loopEnd : total;
-            if (previewPos >= boundary) {
-                if (loopPreview) {
-                    previewPos = loopStart;
-                } else {
-                    previewPlaying = false; previewPos = total;
-                }
-            }
-        }
-        for (const auto meta : midi) {
-            const auto m = meta.getMessage();
-            if (m.isNoteOn()) {
-                int midiNote = m.getNoteNumber();
-                const PadSlice* chosen = nullptr;
-                PadSlice tmpUser;
-                auto it = userSlices.find (midiNote);
-                if (it != userSlices.end()) {
-                    tmpUser = it->second; chosen = &tmpUser;
-                } else {
-                    int idx = midiNote - baseNote;
-                    if (idx >= 0 && idx < (int) slices.size()) chosen = &slices[(size_t) idx];
-                }
-                if (chosen != nullptr && chosen->endSample > chosen->startSample) {
-                    if (chokeEnabled) { for (auto& v : voices) if (v.isActive()) v.kill(); }
-                    for (auto& v : voices) { if (! v.isActive()) { v.startNote (pool.getBuffer(), *chosen); break; } }
-                }
-            } else if (m.isNoteOff()) {
-                if (gateEnabled) {
-                    int note = m.getNoteNumber();
-                    for (auto& v : voices) if (v.isPlayingMidi (note)) v.stopNote();
-                }
-            }
-        }
-        for (auto& v : voices) v.render (buffer, 0, buffer.getNumSamples());
+        renderActive.fetch_add (1);
+        struct RenderExit { std::atomic<int>& count; ~RenderExit() { count.fetch_sub (1); } } renderExit { renderActive };
+        if (decoding.load() || voices.size() == 0) return;
+        // Wait-free view of the slice table for this block; editors publish new tables concurrently
+        const SliceSnapshot::ScopedRead table (sliceTable);
+        // Host MIDI and UI events in sample order. The block is rendered up to each event's
+        // offset before the event is applied, so note-on/off, choke, gate and transport take
+        // effect on the exact sample; cost grows with the number of events, not samples.
+        const int numSamples = buffer.getNumSamples();
+        collectUiEvents (numSamples);
+        int rendered = 0;
+        forEachEvent (midi, [this, &table, &buffer, &rendered, numSamples] (const EngineEvent& e) {
+            const int at = juce::jlimit (rendered, numSamples, e.offset);
+            if (at > rendered) { renderSpan (buffer, rendered, at - rendered); rendered = at; }
+            handleEvent (e, table.get());
+        });
+        if (rendered < numSamples) renderSpan (buffer, rendered, numSamples - rendered);
+        renderMasterBus (buffer);
+        // Play heads for the streaming read-ahead (no-op cost when the files are resident)
+        if (pool().isStreaming()) pool().setPlayHead (0, previewPlaying.load() ? previewPlayPos : -1);
+        voiceAlloc.forEachPlaying ([this] (int v) { voices.publishPlayHead (v); });
     }
-    const SamplePool& getPool() const { return pool; }
-    const std::vector<PadSlice>& getSlices() const { return slices; }
-    const WaveformCache& getWaveform() const { return pool.getWaveform(); }
+    const SamplePool& getPool() const { return pool(); }
+    // Copies taken under dataLock: the workers re-slice and edit them at any time.
+    std::vector<PadSlice> getSlices() const { const rt::ScopedWriterLock sl (dataLock); return slices; }
+    int getNumSlices() const { const rt::ScopedWriterLock sl (dataLock); return (int) slices.size(); }
+    const WaveformCache& getWaveform() const { return pool().getWaveform(); }
     bool isLoading() const { return loading.load(); }
+    // Writes each slice of the current file to 'folder' as a 24-bit WAV in the background
+    // (SliceExporter). False if there is nothing to export, the file is still loading or an
+    // export is already running.
+    bool exportSlices (const juce::File& folder, bool normalise) {
+        SliceExporter::Job job; job.folder = folder; job.normalise = normalise;
+        {
+            const rt::ScopedWriterLock sl (dataLock);
+            auto* e = library.find (&pool());
+            if (e == nullptr || ! e->pool->isFullyLoaded() || slices.empty()) return false;
+            job.source = e->pool; job.slices = slices;
+        }
+        return exporter.start (std::move (job));
+    }
+    void cancelExport() { exporter.cancel(); }
+    bool isExporting() const { return exporter.isRunning(); }
+    float getExportProgress() const { return exporter.getProgress(); }
     // Undo/Redo
     bool canUndo() const { return historyIndex > 0; }
     bool canRedo() const { return historyIndex + 1 < (int) history.size(); }
     bool undo() {
-        const juce::ScopedLock sl (dataLock);
+        const rt::ScopedWriterLock sl (dataLock);
         if (! canUndo()) return false;
-        --historyIndex; restoreFromSnapshot (history[(size_t) historyIndex]);
+        --historyIndex; restoreFromSnapshot (history[(size_t) historyIndex]); publishSlices();
         return true;
     }
     bool redo() {
-        const juce::ScopedLock sl (dataLock);
+        const rt::ScopedWriterLock sl (dataLock);
         if (! canRedo()) return false;
-        ++historyIndex; restoreFromSnapshot (history[(size_t) historyIndex]);
+        ++historyIndex; restoreFromSnapshot (history[(size_t) historyIndex]); publishSlices();
         return true;
     }
     // Editing: move a boundary at slice index 'i' (i >= 1) to 'newSample'.
     bool moveBoundary (int i, int newSample) {
-        const juce::ScopedLock sl (dataLock);
+        const rt::ScopedWriterLock sl (dataLock);
         if (i <= 0 || i >= (int) slices.size()) return false;
         pushSnapshot();
-        const int total = pool.getBuffer().getNumSamples();
+        const int total = sliceLength();
         const int mg = juce::jmax (1, minGapSamples);
         // Boundaries cannot cross neighbours and must respect min gap
         int leftLimit  = slices[(size_t) (i-1)].startSample + mg;
@@ -143,11 +284,12 @@ public:
             float g = it->second; gainByStart.erase (it); gainByStart[clamped] = g;
             slices[(size_t) i].gainLin = g; // keep current slice gain consistent
         }
+        publishSlices();
         return true;
     }
     // Delete slice i: merges into previous if possible, else into next
     bool deleteSlice (int i) {
-        const juce::ScopedLock sl (dataLock);
+        const rt::ScopedWriterLock sl (dataLock);
         if (i < 0 || i >= (int) slices.size()) return false;
         if (slices.size() <= 1) return false;
         pushSnapshot();
@@ -171,135 +313,506 @@ public:
         // Reassign midi notes to keep consecutive mapping from baseNote
         for (size_t k = 0; k < slices.size(); ++k)
             slices[k].midiNote = baseNote + (int) k;
+        publishSlices();
         return true;
     }
-    // Preview controls
-    void togglePreview() { if (pool.getBuffer().getNumSamples() == 0) return; previewPlaying = ! previewPlaying; if (previewPlaying && previewPos >= pool.getBuffer().getNumSamples()) previewPos = 0; }
-    void startPreview() { if (pool.getBuffer().getNumSamples() == 0) return; previewPlaying = true; if (previewPos >= pool.getBuffer().getNumSamples()) previewPos = 0; }
-    void stopPreview()  { previewPlaying = false; }
-    void setLoopPreview (bool shouldLoop) { loopPreview = shouldLoop; }
-    bool isLoopPreview () const { return loopPreview; }
-    // Choke mode (mono)
+    // Pads and transport. Message thread only (the queue has a single producer); the
+    // audio thread applies them at its next block, one block after the time they were posted.
+    void postNoteOn (int midiNote)  { EngineEvent e; e.type = EngineEvent::Type::noteOn;  e.note = midiNote; post (e); }
+    void togglePreview() { EngineEvent e; e.type = EngineEvent::Type::previewToggle; post (e); }
+    void startPreview()  { EngineEvent e; e.type = EngineEvent::Type::previewStart; post (e); }
+    void stopPreview()   { EngineEvent e; e.type = EngineEvent::Type::previewStop; post (e); }
+    void setLoopPreview (bool shouldLoop) { EngineEvent e; e.type = EngineEvent::Type::loopPreview; e.flag = shouldLoop; post (e); }
+    bool isLoopPreview () const { return loopPreview.load(); }
+    // Choke (mono): pads without a choke group of their own all choke each other
     void setChoke (bool shouldChoke) { chokeEnabled = shouldChoke; }
     bool isChokeEnabled () const { return chokeEnabled; }
+    // What a note-on does when all voices are sounding. Audio thread (from processBlock).
+    void setStealPolicy (VoiceStealPolicy p) { stealPolicy = p; }
+    void setResampleQuality (BlockResampler::Quality q) { voices.setResampleQuality (q); }
+    // Realtime-safe. How the next file loaded into RAM is held (float, native or 16-bit PCM).
+    void setSampleStorage (SamplePool::Storage s) { sampleStorage.store (s); }
+    // Realtime-safe. Backend for pitched/stretched pads from the next note; slice renders
+    // are redone with it (picked up by the analysis worker's poll).
+    void setTimePitchBackend (TimePitchEngine::Backend b) { voices.setBackend (b); renderBackend.store (b); }
+    // Realtime-safe. Master key (semitones) and speed on top of every pad. Per voice, both
+    // go into each note's stretch. With onBus (and a pitch-preserving backend built) the key
+    // is instead shifted once on the summed output; speed stays per voice, since a live
+    // bus can't run ahead of or behind real time.
+    // Until the bus stage is built (buildMasterBus()) the key stays per voice.
+    void setMasterKeyTempo (float semitones, float speed, bool onBus) {
+        busWanted.store (onBus);
+        onBus = onBus && busBuilt.load (std::memory_order_acquire);
+        if (onBus && ! keyOnBus.load() && busMix == 0.0f) {
+            // From the dry path: no tail from last time, and the dry output carries on
+            // until the bus has filled (renderMasterBus() then crossfades)
+            bus->reset(); busWarmup = busLatency.load();
+        }
+        if (onBus && semitones != busSemitones) { bus->setRatios (1.0f, semitones); busSemitones = semitones; }
+        keyOnBus.store (onBus);
+        voices.setMasterKeyTempo (onBus ? 0.0f : semitones, speed);
+    }
+    // Not on the audio thread (the processor polls it). Builds the master bus stage the
+    // first time Master Bus mode is asked for; Per Voice sessions never allocate it.
+    void buildMasterBus() {
+        const juce::ScopedLock sl (busBuildLock);
+        if (! busWanted.load() || busBuilt.load() || busBlockSize <= 0) return;
+        // The first pitch-preserving backend built; without one there is no stage
+        for (auto b : { TimePitchEngine::Backend::signalsmith, TimePitchEngine::Backend::rubberband }) {
+            if (! TimePitchEngine::isAvailable (b)) continue;
+            auto stage = std::make_unique<TimePitchEngine>();
+            stage->setBackend (b); stage->prepare (sr, busBlockSize); stage->setRatios (1.0f, 0.0f); stage->reset();
+            busInput.setSize (2, busBlockSize); busDelayed.setSize (2, busBlockSize);
+            busDry.setSize (2, stage->getStreamLatency()); busDry.clear(); busDryPos = 0;
+            busLatency.store (stage->getStreamLatency());
+            bus = std::move (stage);
+            busBuilt.store (true, std::memory_order_release);
+            return;
+        }
+    }
     // Gate mode (stop on note-off)
     void setGate (bool shouldGate) { gateEnabled = shouldGate; }
     bool isGateEnabled () const { return gateEnabled; }
-    void setPreviewPositionNorm (float n) {
-        n = juce::jlimit (0.0f, 1.0f, n);
-        int total = pool.getBuffer().getNumSamples();
-        previewPos = juce::jlimit (0, juce::jmax (0, total-1), (int) std::round (n * (float) total));
-    }
+    void setPreviewPositionNorm (float n) { EngineEvent e; e.type = EngineEvent::Type::previewSeek; e.a = juce::jlimit (0.0f, 1.0f, n); post (e); }
     float getPreviewPositionNorm () const {
-        int total = pool.getBuffer().getNumSamples();
+        const juce::int64 total = pool().getFullLengthInSamples();
         if (total <= 0) return 0.0f;
-        return (float) juce::jlimit (0, total, previewPos) / (float) total;
+        return (float) ((double) juce::jlimit<juce::int64> (0, total, previewPos.load()) / (double) total);
     }
-    int getPreviewSamplePosition() const { return juce::jlimit (0, pool.getBuffer().getNumSamples(), previewPos); }
+    juce::int64 getPreviewSamplePosition() const { return juce::jlimit<juce::int64> (0, pool().getFullLengthInSamples(), previewPos.load()); }
     void setLoopRegionNorm (float a, float b) {
-        a = juce::jlimit (0.0f, 1.0f, a); b = juce::jlimit (0.0f, 1.0f, b);
-        if (pool.getBuffer().getNumSamples() <= 0) { loopStartSample = 0; loopEndSample = 0; return; }
-        if (b < a) std::swap (a, b);
-        int total = pool.getBuffer().getNumSamples();
-        loopStartSample = juce::jlimit (0, total, (int) std::round (a * total));
-        loopEndSample   = juce::jlimit (0, total, (int) std::round (b * total));
+        EngineEvent e; e.type = EngineEvent::Type::loopRegion; e.a = juce::jlimit (0.0f, 1.0f, a); e.b = juce::jlimit (0.0f, 1.0f, b); post (e);
     }
     std::pair<float,float> getLoopRegionNorm() const {
-        int total = pool.getBuffer().getNumSamples();
-        if (total <= 0 || loopEndSample <= loopStartSample) return { 0.f, 1.f };
-        return { loopStartSample / (float) total, loopEndSample / (float) total };
-    }
-    void tapSliceAtCurrent() {
-        pushSnapshot();
-        const juce::ScopedLock sl (dataLock);
-        if (pool.getBuffer().getNumSamples() == 0) return;
-        int s = juce::jlimit (0, pool.getBuffer().getNumSamples()-1, previewPos);
-        manualTaps.push_back (s);
-        // Deduplicate nearby taps
-        std::sort (manualTaps.begin(), manualTaps.end());
-        const int mg = juce::jmax (1, minGapSamples);
-        manualTaps.erase (std::unique (manualTaps.begin(), manualTaps.end(), [mg](int a, int b){ return std::abs (a-b) < mg; }), manualTaps.end());
-        buildSlices();
+        const juce::int64 total = pool().getFullLengthInSamples();
+        const juce::int64 loopStart = loopStartSample.load(), loopEnd = loopEndSample.load();
+        if (total <= 0 || loopEnd <= loopStart) return { 0.f, 1.f };
+        return { (float) ((double) loopStart / (double) total), (float) ((double) loopEnd / (double) total) };
     }
+    // Edits at the play position. Posted like pads so the audio thread stamps the exact
+    // preview sample; the analysis worker then applies them under the writer locks.
+    void tapSliceAtCurrent() { EngineEvent e; e.type = EngineEvent::Type::tapSlice; post (e); }
     // Create a user-mapped slice at current preview position, assigned to specific midi note
     void createUserSliceAtCurrent (int midiNote, bool quantizeToTransient) {
-        const juce::ScopedLock sl (dataLock);
-        if (pool.getBuffer().getNumSamples() == 0) return;
-        int s = juce::jlimit (0, pool.getBuffer().getNumSamples()-1, previewPos);
-        if (quantizeToTransient) {
-            // snap to nearest detected transient using current slicer settings
-            const auto points = slicer.slice (pool.getBuffer(), 0, juce::jmax (8, juce::jmin (maxSlices, 128)));
-            int best = s; int bestD = INT_MAX;
-            for (const auto& pt : points) {
-                int d = std::abs (pt.sampleIndex - s); if (d < bestD) { bestD = d; best = pt.sampleIndex; }
-            }
-            s = best;
-        }
-        // Default length: until next transient or +1s, whichever comes first
-        int e = juce::jmin (pool.getBuffer().getNumSamples(), s + (int) std::round (sr));
-        if (quantizeToTransient) {
-            const auto points = slicer.slice (pool.getBuffer(), 0, juce::jmax (8, juce::jmin (maxSlices, 128)));
-            for (const auto& pt : points) { if (pt.sampleIndex > s) { e = juce::jmax (s + juce::jmax (1, minGapSamples), pt.sampleIndex); break; } }
-        }
-        PadSlice ps; ps.startSample = s; ps.endSample = e; ps.midiNote = midiNote; ps.gainLin = 1.0f;
-        userSlices[midiNote] = ps;
+        EngineEvent e; e.type = EngineEvent::Type::userSlice; e.note = midiNote; e.flag = quantizeToTransient; post (e);
     }
-    bool hasUserSlice (int midiNote) const { return userSlices.find (midiNote) != userSlices.end(); }
+    bool hasUserSlice (int midiNote) const { const rt::ScopedWriterLock sl (dataLock); return userSlices.find (midiNote) != userSlices.end(); }
     // Per-slice gain control
     void setSliceGainDb (int index, float gainDb) {
-        const juce::ScopedLock sl (dataLock);
+        const rt::ScopedWriterLock sl (dataLock);
         if (index < 0 || index >= (int) slices.size()) return;
         float g = juce::Decibels::decibelsToGain (gainDb);
         slices[(size_t) index].gainLin = g;
         gainByStart[slices[(size_t) index].startSample] = g;
+        publishSlices();
     }
     float getSliceGainDb (int index) const {
-        const juce::ScopedLock sl (dataLock);
+        const rt::ScopedWriterLock sl (dataLock);
         if (index < 0 || index >= (int) slices.size()) return 0.0f;
         return juce::Decibels::gainToDecibels (slices[(size_t) index].gainLin);
     }
     // Per-slice pitch/time/reverse
     void setSlicePitchSemitones (int index, float semitones) {
-        const juce::ScopedLock sl (dataLock);
+        const rt::ScopedWriterLock sl (dataLock);
         if (index < 0 || index >= (int) slices.size()) return;
         slices[(size_t) index].pitchSemitones = juce::jlimit (-24.0f, 24.0f, semitones);
+        publishSlices();
     }
     float getSlicePitchSemitones (int index) const {
-        const juce::ScopedLock sl (dataLock);
+        const rt::ScopedWriterLock sl (dataLock);
         if (index < 0 || index >= (int) slices.size()) return 0.0f;
         return slices[(size_t) index].pitchSemitones;
     }
     void setSliceTimeRatio (int index, float ratio) {
-        const juce::ScopedLock sl (dataLock);
+        const rt::ScopedWriterLock sl (dataLock);
         if (index < 0 || index >= (int) slices.size()) return;
         slices[(size_t) index].timeRatio = juce::jlimit (0.25f, 4.0f, ratio);
+        publishSlices();
     }
     float getSliceTimeRatio (int index) const {
-        const juce::ScopedLock sl (dataLock);
+        const rt::ScopedWriterLock sl (dataLock);
         if (index < 0 || index >= (int) slices.size()) return 1.0f;
         return slices[(size_t) index].timeRatio;
     }
     void setSliceReverse (int index, bool rev) {
-        const juce::ScopedLock sl (dataLock);
+        const rt::ScopedWriterLock sl (dataLock);
         if (index < 0 || index >= (int) slices.size()) return;
         slices[(size_t) index].reverse = rev;
+        publishSlices();
     }
     bool getSliceReverse (int index) const {
-        const juce::ScopedLock sl (dataLock);
+        const rt::ScopedWriterLock sl (dataLock);
         if (index < 0 || index >= (int) slices.size()) return false;
         return slices[(size_t) index].reverse;
     }
-    int getTotalLengthSamples() const { return pool.getBuffer().getNumSamples(); }
+    // Per-slice choke group (0 = none)
+    void setSliceChokeGroup (int index, int group) {
+        const rt::ScopedWriterLock sl (dataLock);
+        if (index < 0 || index >= (int) slices.size()) return;
+        slices[(size_t) index].chokeGroup = juce::jlimit (0, PadSlice::maxChokeGroups, group);
+        publishSlices();
+    }
+    int getSliceChokeGroup (int index) const {
+        const rt::ScopedWriterLock sl (dataLock);
+        if (index < 0 || index >= (int) slices.size()) return 0;
+        return slices[(size_t) index].chokeGroup;
+    }
+    // Full length in the slice domain (int sample indices; files are sliceable up to INT_MAX
+    // samples). The normalised positions above use it too, so the view doesn't rescale while
+    // a file loads; only the first getPool().getLengthInSamples() are playable until then.
+    int getTotalLengthSamples() const { return (int) juce::jmin<juce::int64> (pool().getFullLengthInSamples(), std::numeric_limits<int>::max()); }
     private:
-    void buildSlices() {
-        slices.clear();
-        if (pool.getBuffer().getNumSamples() == 0) return;
-        slicer.setThresholdScale (sensitivity);
-        auto slicePoints = slicer.slice (pool.getBuffer(), 0, maxSlices);
+    // Copies the writer-side slice state into a fresh immutable table for the audio thread.
+    // Caller holds dataLock.
+    void publishSlices() {
+        auto table = std::make_unique<SliceTable>();
+        table->slices = slices; table->gainByStart = gainByStart; table->userSlices = userSlices; table->baseNote = baseNote;
+        // Every slice names the file it plays, and the table keeps those files alive
+        const auto attachSource = [&] (PadSlice& s) {
+            if (s.source == nullptr) s.source = &pool();
+            for (auto& p : table->sources) if (p.get() == s.source) return;
+            if (auto* e = library.find (s.source)) table->sources.push_back (e->pool);
+        };
+        for (auto& s : table->slices) attachSource (s);
+        for (auto& kv : table->userSlices) attachSource (kv.second);
+        // Point pitched/stretched/reversed slices at their renders; missing ones get queued
+        publishedBackend = renderBackend.load();
+        std::vector<SliceRenderer::Key> wanted;
+        const auto attachRender = [&] (PadSlice& s) {
+            if (! SliceRenderer::wants (s)) return;
+            wanted.push_back (SliceRenderer::keyFor (s, publishedBackend.load()));
+            if (auto r = renderer.find (wanted.back())) { s.rendered = r.get(); table->renders.push_back (std::move (r)); }
+        };
+        for (auto& s : table->slices) attachRender (s);
+        for (auto& kv : table->userSlices) attachRender (kv.second);
+        renderer.retainOnly (wanted);
+        table->resolve();
+        // Keep the first moments of every streamed pad resident so note-ons don't page-fault
+        library.forEach ([&table] (SampleLibrary::Entry& e) {
+            if (! e.pool->isStreaming()) return;
+            std::vector<juce::Range<juce::int64>> heads;
+            const auto headLen = (juce::int64) (e.pool->getSampleRate() * 0.25);
+            for (auto* s : table->byNote)
+                if (s != nullptr && s->source == e.pool.get()) heads.push_back ({ s->startSample, juce::jmin<juce::int64> (s->endSample, s->startSample + headLen) });
+            e.pool->setHotRegions (std::move (heads));
+        });
+        sliceTable.publish (std::move (table));
+    }
+    // Key shift on the summed output while the key is on the bus; otherwise the output
+    // passes through undelayed. Switching crossfades the two paths over one block.
+    void renderMasterBus (juce::AudioBuffer<float>& buffer) {
+        if (! busBuilt.load (std::memory_order_acquire)) return;
+        const bool on = keyOnBus.load();
+        const float target = on ? 1.0f : 0.0f, step = 1.0f / (float) busBlockSize;
+        const int numCh = juce::jmin (2, buffer.getNumChannels());
+        for (int start = 0; start < buffer.getNumSamples();) {
+            const int n = juce::jmin (buffer.getNumSamples() - start, busInput.getNumSamples());
+            delayBusDry (buffer, start, n, numCh);
+            if (on || busMix > 0.0f) {
+                for (int c = 0; c < numCh; ++c) busInput.copyFrom (c, 0, buffer, c, start, n);
+                std::array<float*, 2> out { buffer.getWritePointer (0, start), buffer.getWritePointer (numCh - 1, start) };
+                bus->processStream (busInput.getArrayOfReadPointers(), out.data(), numCh, n);
+                if (busWarmup > 0 || busMix != target) {
+                    // While the bus latency is reported the dry side is heard that late too
+                    const auto& dry = on ? busDelayed : busInput;
+                    for (int k = 0; k < n; ++k) {
+                        if (busWarmup > 0) --busWarmup;
+                        else busMix = target > busMix ? juce::jmin (target, busMix + step) : juce::jmax (target, busMix - step);
+                        for (int c = 0; c < numCh; ++c) { const float x = dry.getSample (c, k); out[(size_t) c][k] = x + (out[(size_t) c][k] - x) * busMix; }
+                    }
+                }
+            }
+            start += n;
+        }
+    }
+    // Audio thread: the dry output busLatency samples late, into busDelayed. Fed on every
+    // block once the bus is built, so switching on finds the delay line already filled.
+    void delayBusDry (const juce::AudioBuffer<float>& buffer, int start, int n, int numCh) {
+        const int len = busDry.getNumSamples();
+        for (int c = 0; c < numCh; ++c) {
+            if (len == 0) { busDelayed.copyFrom (c, 0, buffer, c, start, n); continue; }
+            const float* in = buffer.getReadPointer (c, start);
+            float* line = busDry.getWritePointer (c); float* d = busDelayed.getWritePointer (c);
+            for (int k = 0, p = busDryPos; k < n; ++k, p = p + 1 == len ? 0 : p + 1) { d[k] = line[p]; line[p] = in[k]; }
+        }
+        if (len > 0) busDryPos = (busDryPos + n) % len;
+    }
+    // Renderer thread: copies a slice's playback (host-rate) audio, if its file is still
+    // in the library and the key is current.
+    bool readForRender (const SliceRenderer::Key& k, juce::AudioBuffer<float>& dest) {
+        const rt::ScopedWriterLock al (analysisLock);
+        const auto* e = library.find (k.source);
+        if (e == nullptr || e->pool->getId() != k.sourceId || e->pool->getPlaybackRate() != k.rate) return false;
+        const auto& src = *e->pool;
+        const juce::int64 start = src.toPlayback (k.start), end = src.toPlayback (k.end);
+        if (start < 0 || end <= start || end > src.getPlaybackLength()) return false;
+        dest.setSize (2, (int) (end - start));
+        src.readPlayback (dest, 0, start, (int) (end - start));
+        return true;
+    }
+    void post (EngineEvent e) { e.timeMs = juce::Time::getMillisecondCounterHiRes(); uiEvents.push (e); }
+    // Audio thread: moves this block's UI events into uiBlock. An event lands at the offset
+    // it was posted at within the previous block, so UI latency is one block with no jitter.
+    void collectUiEvents (int numSamples) {
+        const double now = juce::Time::getMillisecondCounterHiRes();
+        numUiBlock = 0;
+        for (EngineEvent e; numUiBlock < (int) uiBlock.size() && uiEvents.pop (e);) {
+            const double late = lastBlockMs > 0.0 ? (e.timeMs - lastBlockMs) * sr / 1000.0 : 0.0;
+            e.offset = juce::jlimit (0, juce::jmax (0, numSamples - 1), (int) late);
+            uiBlock[(size_t) numUiBlock++] = e;
+        }
+        lastBlockMs = now;
+    }
+    // Host MIDI merged with uiBlock in sample order (host first on ties). UI events are
+    // already in order: one producer, increasing timestamps.
+    template <typename Fn>
+    void forEachEvent (const juce::MidiBuffer& midi, Fn&& fn) {
+        int ui = 0;
+        for (const auto meta : midi) {
+            while (ui < numUiBlock && uiBlock[(size_t) ui].offset < meta.samplePosition) fn (uiBlock[(size_t) ui++]);
+            const auto m = meta.getMessage();
+            if (! m.isNoteOn() && ! m.isNoteOff()) continue;
+            EngineEvent e; e.type = m.isNoteOn() ? EngineEvent::Type::noteOn : EngineEvent::Type::noteOff;
+            e.note = m.getNoteNumber(); e.offset = meta.samplePosition;
+            fn (e);
+        }
+        while (ui < numUiBlock) fn (uiBlock[(size_t) ui++]);
+    }
+    // Audio thread.
+    void handleEvent (const EngineEvent& e, const SliceTable* table) {
+        const juce::int64 full = pool().getFullLengthInSamples();
+        switch (e.type) {
+            case EngineEvent::Type::noteOn: {
+                const PadSlice* chosen = table != nullptr ? table->byNote[(size_t) juce::jlimit (0, 127, e.note)] : nullptr;
+                if (chosen != nullptr && chosen->endSample > chosen->startSample) {
+                    const auto fade = [this] (int v) { voices.fadeOut (v); };
+                    const int group = chosen->chokeGroup > 0 ? chosen->chokeGroup : (chokeEnabled ? monoChokeGroup : 0);
+                    voiceAlloc.choke (group, fade);
+                    const int v = voiceAlloc.noteOn (e.note, group, stealPolicy, [this] (int i) { return voices.getLevel (i); }, fade);
+                    voices.start (v, *chosen->source, *chosen);
+                }
+                break;
+            }
+            case EngineEvent::Type::noteOff:
+                if (gateEnabled) voiceAlloc.forEachOnNote (e.note, [this] (int v) { voices.stop (v); });
+                break;
+            case EngineEvent::Type::previewToggle:
+            case EngineEvent::Type::previewStart:
+                if (pool().getLengthInSamples() == 0) break;
+                // Starting playback waits out the pad latency like a note-on does
+                if (! previewPlaying.load()) previewDelayLeft = voices.getLatency();
+                previewPlaying.store (e.type == EngineEvent::Type::previewStart || ! previewPlaying.load());
+                if (previewPlaying.load() && previewPos.load() >= full) seekPreview (0);
+                break;
+            case EngineEvent::Type::previewStop: previewPlaying.store (false); break;
+            case EngineEvent::Type::previewSeek:
+                seekPreview (juce::jlimit<juce::int64> (0, juce::jmax<juce::int64> (0, full-1), (juce::int64) std::round ((double) e.a * (double) full)));
+                break;
+            case EngineEvent::Type::loopPreview: loopPreview.store (e.flag); break;
+            case EngineEvent::Type::loopRegion: {
+                const float a = juce::jmin (e.a, e.b), b = juce::jmax (e.a, e.b);
+                loopStartSample.store (juce::jlimit<juce::int64> (0, full, (juce::int64) std::round ((double) a * (double) full)));
+                loopEndSample.store   (juce::jlimit<juce::int64> (0, full, (juce::int64) std::round ((double) b * (double) full)));
+                break;
+            }
+            case EngineEvent::Type::tapSlice:
+            case EngineEvent::Type::userSlice:
+                sliceEdits.push ({ e.type == EngineEvent::Type::userSlice, e.note, e.flag, previewPos.load() });
+                break;
+        }
+    }
+    // Audio thread: everything that plays, over [start, start+num) of the block.
+    void renderSpan (juce::AudioBuffer<float>& buffer, int start, int num) {
+        renderPreview (buffer, start, num);
+        int numPlaying = 0;
+        voiceAlloc.forEachPlaying ([this, &numPlaying] (int v) { playing[(size_t) numPlaying++] = v; });
+        voices.render (buffer, start, num, playing.data(), numPlaying);
+        for (int k = 0; k < numPlaying; ++k)
+            if (const int v = playing[(size_t) k]; ! voices.isActive (v)) voiceAlloc.release (v);
+    }
+    // Audio thread. previewPos (file samples) is what the UI and slice edits see; preview
+    // plays from previewPlayPos (playback samples) so it never drifts through the mapping.
+    void seekPreview (juce::int64 sourcePos) { previewPos.store (sourcePos); previewPlayPos = pool().toPlayback (sourcePos); }
+    // Audio thread: preview playback of the long file.
+    void renderPreview (juce::AudioBuffer<float>& buffer, int start, int num) {
+        const juce::int64 total = pool().getPlaybackLength();
+        if (! previewPlaying.load() || total <= 0) return;
+        if (previewDelayLeft > 0) {
+            const int skip = juce::jmin (previewDelayLeft, num);
+            previewDelayLeft -= skip; start += skip; num -= skip;
+            if (num == 0) return;
+        }
+        const juce::int64 loopStart = juce::jlimit<juce::int64> (0, total, pool().toPlayback (loopStartSample.load()));
+        const juce::int64 loopEnd   = juce::jlimit<juce::int64> (loopStart, total, loopEndSample.load() > 0 ? pool().toPlayback (loopEndSample.load()) : total);
+        juce::int64 pos = previewPlayPos;
+        const int toCopy = (int) juce::jlimit<juce::int64> (0, num, total - pos);
+        for (int done = 0; done < toCopy;) {
+            const int n = juce::jmin (toCopy - done, previewScratch.capacity());
+            const float* const* src = pool().getReadPointers (pos, n, previewScratch);
+            for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
+                buffer.addFrom (ch, start + done, src[juce::jmin (ch, 1)], n, 0.5f);
+            pos += n; done += n;
+        }
+        const juce::int64 boundary = loopPreview.load() ? loopEnd : total;
+        if (pos >= boundary) {
+            if (loopPreview.load()) {
+                pos = loopStart;
+            } else if (pool().isFullyLoaded()) {
+                previewPlaying.store (false); pos = total;
+            } // else caught up with the loader: hold here until the next chunk lands
+        }
+        previewPlayPos = pos; previewPos.store (pool().toSource (pos));
+    }
+    // Worker thread: applies taps/user slices stamped by the audio thread. True if any ran.
+    bool applySliceEdits() {
+        bool any = false;
+        if (renderBackend.load() != publishedBackend) { const rt::ScopedWriterLock sl (dataLock); publishSlices(); }
+        for (SliceEdit e; sliceEdits.pop (e); any = true) {
+            if (e.userSlice) createUserSlice (e.note, e.quantize, e.position);
+            else             tapSlice (e.position);
+        }
+        return any;
+    }
+    void tapSlice (juce::int64 position) {
+        const rt::ScopedWriterLock al (analysisLock);
+        const rt::ScopedWriterLock sl (dataLock);
+        if (sliceLength() == 0) return;
+        pushSnapshot();
+        int s = (int) juce::jlimit<juce::int64> (0, sliceLength()-1, position);
+        manualTaps.push_back (s);
+        // Deduplicate nearby taps
+        std::sort (manualTaps.begin(), manualTaps.end());
+        const int mg = juce::jmax (1, minGapSamples);
+        manualTaps.erase (std::unique (manualTaps.begin(), manualTaps.end(), [mg](int a, int b){ return std::abs (a-b) < mg; }), manualTaps.end());
+        buildSlices (detectOnsets());
+    }
+    void createUserSlice (int midiNote, bool quantizeToTransient, juce::int64 position) {
+        const rt::ScopedWriterLock al (analysisLock);
+        if (sliceLength() == 0) return;
+        // Onsets come from the cached novelty curve; refreshed only when the pick settings change
+        const int target = juce::jmax (8, juce::jmin (maxSlices, 128));
+        if (quantizeToTransient && (quantizeKey.sensitivity != sensitivity || quantizeKey.median != medianThreshold || quantizeKey.target != target
+                                    || quantizeKey.source != pool().getId() || quantizeKey.length != sliceLength())) {
+            quantizeOnsets.clear();
+            for (const auto& pt : analysis.detect (pool(), sensitivity, medianThreshold, target)) quantizeOnsets.push_back (pt.sampleIndex);
+            quantizeKey = { sensitivity, medianThreshold, target, pool().getId(), sliceLength() };
+        }
+        const rt::ScopedWriterLock sl (dataLock);
+        int s = (int) juce::jlimit<juce::int64> (0, sliceLength()-1, position);
+        if (quantizeToTransient && ! quantizeOnsets.empty()) {
+            // snap to nearest detected transient (onsets are sorted; ties go to the earlier one)
+            auto it = std::lower_bound (quantizeOnsets.begin(), quantizeOnsets.end(), s);
+            int best = it != quantizeOnsets.end() ? *it : quantizeOnsets.back();
+            if (it != quantizeOnsets.begin() && (it == quantizeOnsets.end() || std::abs (*(it - 1) - s) <= std::abs (*it - s)))
+                best = *(it - 1);
+            s = best;
+        }
+        // Default length: until next transient or +1s, whichever comes first
+        int e = juce::jmin (sliceLength(), s + (int) std::round (sr));
+        if (quantizeToTransient) {
+            auto next = std::upper_bound (quantizeOnsets.begin(), quantizeOnsets.end(), s);
+            if (next != quantizeOnsets.end()) e = juce::jmax (s + juce::jmax (1, minGapSamples), *next);
+        }
+        PadSlice ps; ps.startSample = s; ps.endSample = e; ps.midiNote = midiNote; ps.gainLin = 1.0f;
+        ps.source = &pool(); // stays on this file when another is loaded
+        userSlices[midiNote] = ps;
+        publishSlices();
+    }
+    // Worker thread: re-slice for new controls and publish the result.
+    void applySliceControls (const SliceAnalysisWorker::Controls& c) {
+        const rt::ScopedWriterLock al (analysisLock);
+        const bool pickChanged = maxSlices != c.maxSlices || std::abs (sensitivity - c.sensitivity) > 1.0e-4f || medianThreshold != c.medianThreshold;
+        if (baseNote == c.baseNote && ! pickChanged) return;
+        std::vector<SlicePoint> points;
+        if (pickChanged || lastOnsets.empty())
+            points = sliceLength() > 0 ? analysis.detect (pool(), c.sensitivity, c.medianThreshold, c.maxSlices) : std::vector<SlicePoint>{};
+        else
+            points = lastOnsets; // base note only: reuse the previous detection
+        const rt::ScopedWriterLock sl (dataLock);
+        pushSnapshot();
+        baseNote = c.baseNote; maxSlices = c.maxSlices; sensitivity = c.sensitivity; medianThreshold = c.medianThreshold;
+        buildSlices (points);
+    }
+    int sliceLength() const { return (int) juce::jmin<juce::int64> (pool().getAnalysisLength(), std::numeric_limits<int>::max()); }
+    // Loader thread: slices whatever is decoded so far. The FFT pass runs under
+    // analysisLock only, so editors keep working while it runs.
+    void sliceLoadedAudio() {
+        const rt::ScopedWriterLock al (analysisLock);
+        const auto points = detectOnsets();
+        const rt::ScopedWriterLock sl (dataLock);
+        buildSlices (points);
+    }
+    // Caller holds analysisLock (keeps the pool buffer and slicer settings stable). The
+    // pick is cached on the library entry, so returning to a file doesn't redo it.
+    std::vector<SlicePoint> detectOnsets() {
+        if (sliceLength() == 0) return {};
+        const SampleLibrary::OnsetKey key { sensitivity, medianThreshold, maxSlices, pool().getAnalysisLength() };
+        auto* e = library.find (&pool());
+        if (e != nullptr && e->onsetKey == key) return e->onsets;
+        auto points = analysis.detect (pool(), sensitivity, medianThreshold, maxSlices);
+        if (e != nullptr) { e->onsetKey = key; e->onsets = points; }
+        return points;
+    }
+    // Loader thread, once a file has decoded and been sliced: keeps its waveform, novelty
+    // curve and onsets on disk for the next time it is opened.
+    void saveAnalysis (const juce::File& f, const juce::String& hash, const SamplePool& p) {
+        AnalysisCache::Record r; r.hash = hash;
+        {
+            const rt::ScopedWriterLock al (analysisLock);
+            if (! p.isAnalysed()) return;
+            r.firstLevel = p.getWaveform().getFirstLevel();
+            for (int l = 0; l < WaveformCache::numLevels; ++l)
+                if (const auto v = p.getWaveform().get (l); v.bins != nullptr) r.levels[(size_t) l].assign (v.bins->begin(), v.bins->end());
+            r.novelty = p.getNovelty();
+            if (auto* e = library.find (&p)) { r.onsetKey = e->onsetKey; r.onsets = e->onsets; }
+        }
+        analysisCache.save (f, r);
+    }
+    // Loader thread, with the content hash of the file being decoded into 'loaded'. If an
+    // entry with that content has fully decoded, it takes over (the file joins its entry,
+    // this decode is dropped) and this returns true. Otherwise the hash goes on the new
+    // entry, and a partial decode of the same content is retired.
+    bool mergeDuplicate (const juce::File& f, SamplePool& loaded, const juce::String& hash) {
+        const rt::ScopedWriterLock al (analysisLock);
+        const rt::ScopedWriterLock sl (dataLock);
+        auto* mine = library.find (&loaded);
+        if (mine == nullptr || hash.isEmpty()) return false;
+        auto* other = library.find (hash);
+        if (other == nullptr || ! other->pool->isFullyLoaded()) {
+            if (other != nullptr) library.retire (*other);
+            mine->hash = hash;
+            return false;
+        }
+        other->files.addIfNotAlreadyThere (SampleLibrary::fileId (f));
+        if (&pool() == &loaded) makeCurrent (*other);
+        library.retire (*mine);
+        return true;
+    }
+    // Caller holds analysisLock and dataLock. Switches the current file (behind the
+    // render fence), swapping in its slice edits and slicing it. Sounding voices play on:
+    // each holds its own file, which the library keeps while it plays.
+    void makeCurrent (SampleLibrary::Entry& e) {
+        if (auto* old = library.find (&pool())) { old->manualTaps = manualTaps; old->gainByStart = gainByStart; }
+        e.pool->setPlaybackRate (sr);
+        decoding.store (true);
+        while (renderActive.load() > 0) std::this_thread::yield();
+        pool().setPlayHead (0, -1);
+        currentPool.store (e.pool.get());
+        previewPos.store (0); previewPlayPos = 0;
+        decoding.store (false);
+        library.touch (e);
+        manualTaps = e.manualTaps; gainByStart = e.gainByStart;
+        history.clear(); historyIndex = -1; // snapshots are of the other file's slices
+        buildSlices (detectOnsets());
+    }
+    // Caller holds dataLock.
+    void buildSlices (const std::vector<SlicePoint>& slicePoints) {
+        slices.clear(); lastOnsets = slicePoints;
+        if (sliceLength() == 0) { publishSlices(); return; }
         std::vector<int> starts; starts.reserve (slicePoints.size() + manualTaps.size() + 1);
         starts.push_back (0);
         for (auto& sp : slicePoints) starts.push_back (sp.sampleIndex);
-        for (auto s : manualTaps) starts.push_back (juce::jlimit (0, pool.getBuffer().getNumSamples()-1, s));
+        for (auto s : manualTaps) starts.push_back (juce::jlimit (0, sliceLength()-1, s));
         std::sort (starts.begin(), starts.end());
         // Dedup close points
         const int mg = juce::jmax (1, minGapSamples);
@@ -307,19 +820,59 @@ public:
         if ((int) starts.size() > maxSlices) starts.resize ((size_t) maxSlices);
         for (size_t i = 0; i < starts.size(); ++i) {
             int start = starts[i];
-            int end = (i + 1 < starts.size()) ? starts[i+1] : pool.getBuffer().getNumSamples();
+            int end = (i + 1 < starts.size()) ? starts[i+1] : sliceLength();
             float g = 1.0f; auto it = gainByStart.find (start); if (it != gainByStart.end()) g = it->second;
             PadSlice ps; ps.startSample = start; ps.endSample = end; ps.midiNote = (int) (baseNote + (int) i); ps.gainLin = g;
             slices.push_back (ps);
         }
+        publishSlices();
     }
-    juce::CriticalSection dataLock;
-    std::atomic<bool> loading { false };
+    // Lock order: analysisLock (pool buffer + slicer settings) before dataLock. The library
+    // changes under both.
+    // Guards the writer-side slice state below; the audio thread never takes either
+    juce::CriticalSection analysisLock, dataLock;
+    using SliceSnapshot = RealtimeSnapshot<SliceTable>;
+    SliceSnapshot sliceTable;
+    std::atomic<int> renderActive { 0 }; std::atomic<bool> decoding { false };
+    std::atomic<bool> loading { false }; std::atomic<bool> cancelLoad { false };
     std::unique_ptr<std::thread> loader;
-    double sr { 44100.0 }; SamplePool pool; SpectralFluxSlicer slicer;
-    std::array<PadVoice, 32> voices; std::vector<PadSlice> slices; int baseNote { 36 }; int maxSlices { 64 }; float sensitivity { 1.2f };
-    std::vector<int> manualTaps; int previewPos { 0 }; bool previewPlaying { false }; bool loopPreview { false };
-    int loopStartSample { 0 }; int loopEndSample { 0 };
+    static constexpr double firstSliceSeconds = 8.0;
+    // Decoded files by content. The current one is what the waveform, preview, slicing and
+    // the auto slices use; it changes only behind the render fence (makeCurrent()).
+    SampleLibrary library; SamplePool emptyPool; std::atomic<SamplePool*> currentPool { &emptyPool };
+    SamplePool& pool() const { return *currentPool.load(); }
+    AnalysisCache analysisCache; // loader thread
+    SliceExporter exporter;
+    double sr { 44100.0 }; SliceAnalysisWorker analysis; SliceRenderer renderer; std::vector<SlicePoint> lastOnsets;
+    // Quantize-to-transient onsets (guarded by analysisLock)
+    struct QuantizeKey { float sensitivity { -1.0f }; bool median { false }; int target { 0 }; juce::uint32 source { 0 }; int length { -1 }; } quantizeKey;
+    std::vector<int> quantizeOnsets;
+    // Voices: polyphony may sound at once, the spare voices carry fade-outs of stolen and
+    // choked notes. Sized in prepare(), audio thread only after that.
+    static constexpr int monoChokeGroup = PadSlice::maxChokeGroups + 1;
+    PadVoiceBank voices; int polyphony { 32 }; std::vector<int> playing;
+    VoiceAllocator<monoChokeGroup + 1> voiceAlloc; VoiceStealPolicy stealPolicy { VoiceStealPolicy::oldest };
+    // Time/pitch backend: set by the audio thread, applied to slice renders by publishSlices()
+    std::atomic<TimePitchEngine::Backend> renderBackend { TimePitchEngine::Backend::signalsmith };
+    std::atomic<TimePitchEngine::Backend> publishedBackend { TimePitchEngine::Backend::signalsmith };
+    std::atomic<SamplePool::Storage> sampleStorage { SamplePool::Storage::native };
+    // Master bus key stage: built off the audio thread (buildMasterBus()), published by
+    // busBuilt; the audio thread owns it from then on until the next prepare()
+    std::unique_ptr<TimePitchEngine> bus; juce::AudioBuffer<float> busInput; int busBlockSize { 0 };
+    juce::CriticalSection busBuildLock; std::atomic<bool> busWanted { false }, busBuilt { false }, keyOnBus { false };
+    std::atomic<int> busLatency { 0 }; float busSemitones { 0.0f };
+    juce::AudioBuffer<float> busDry, busDelayed; int busDryPos { 0 }; // dry delay line (busLatency long) and its output
+    float busMix { 0.0f }; int busWarmup { 0 }; // bus share of the output, and dry samples left while the bus fills
+    std::vector<PadSlice> slices; int baseNote { 36 }; int maxSlices { 64 }; float sensitivity { 1.2f }; bool medianThreshold { false };
+    // Transport: written by the audio thread only (from events), read by the UI
+    std::vector<int> manualTaps; std::atomic<juce::int64> previewPos { 0 }; std::atomic<bool> previewPlaying { false }; std::atomic<bool> loopPreview { false };
+    std::atomic<juce::int64> loopStartSample { 0 }; std::atomic<juce::int64> loopEndSample { 0 }; SampleReadScratch previewScratch;
+    juce::int64 previewPlayPos { 0 }; int previewDelayLeft { 0 }; // audio thread (and prepare())
+    // UI -> audio events, and edits stamped by the audio thread for the analysis worker
+    static constexpr int maxUiEvents = 256;
+    RealtimeQueue<EngineEvent, maxUiEvents> uiEvents; std::array<EngineEvent, maxUiEvents> uiBlock; int numUiBlock { 0 }; double lastBlockMs { 0.0 };
+    struct SliceEdit { bool userSlice { false }; int note { 0 }; bool quantize { false }; juce::int64 position { 0 }; };
+    RealtimeQueue<SliceEdit, 64> sliceEdits;
     int minGapSamples { 128 }; float minGapMs { 30.0f };
       std::map<int, float> gainByStart;
       std::map<int, PadSlice> userSlices; // per-MIDI-note user-assigned slices (Edit mode)
@@ -0,0 +1,119 @@
+#pragma once
+#include <juce_core/juce_core.h>
+#include <cmath>
+#if JUCE_USE_SSE_INTRINSICS
+ #include <immintrin.h>
+#endif
+#if JUCE_USE_ARM_NEON
+ #include <arm_neon.h>
+#endif
+
+// Fused spectral-flux kernel for SpectralFluxSlicer.
+// One pass over a real-only FFT frame computes each bin magnitude, accumulates the
+// half-wave-rectified difference against prevMag and stores the new magnitude back
+// into prevMag. Bin k pairs spec[k] with spec[size-1-k], matching the slicer's
+// original scalar loop. The best available SIMD path is picked once at runtime.
+namespace flux {
+    using KernelFn = float (*) (const float* spec, int size, float* prevMag);
+
+    inline float kernelScalar (const float* spec, int size, float* prevMag) {
+        float sum = 0.0f;
+        for (int k = 0; k < size / 2; ++k) {
+            const float re = spec[k], im = spec[size - 1 - k];
+            const float m = std::sqrt (re * re + im * im);
+            const float d = m - prevMag[k];
+            if (d > 0) sum += d;
+            prevMag[k] = m;
+        }
+        return sum;
+    }
+
+   #if JUCE_USE_SSE_INTRINSICS
+    inline float kernelSSE (const float* spec, int size, float* prevMag) {
+        const int half = size / 2; int k = 0;
+        __m128 acc = _mm_setzero_ps(); const __m128 zero = _mm_setzero_ps();
+        for (; k + 4 <= half; k += 4) {
+            const __m128 re = _mm_loadu_ps (spec + k);
+            __m128 im = _mm_loadu_ps (spec + size - 4 - k);
+            im = _mm_shuffle_ps (im, im, _MM_SHUFFLE (0, 1, 2, 3)); // reverse lanes
+            const __m128 m = _mm_sqrt_ps (_mm_add_ps (_mm_mul_ps (re, re), _mm_mul_ps (im, im)));
+            acc = _mm_add_ps (acc, _mm_max_ps (_mm_sub_ps (m, _mm_loadu_ps (prevMag + k)), zero));
+            _mm_storeu_ps (prevMag + k, m);
+        }
+        alignas (16) float lanes[4]; _mm_store_ps (lanes, acc);
+        float sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+        for (; k < half; ++k) {
+            const float re = spec[k], im = spec[size - 1 - k];
+            const float m = std::sqrt (re * re + im * im);
+            const float d = m - prevMag[k]; if (d > 0) sum += d;
+            prevMag[k] = m;
+        }
+        return sum;
+    }
+    #if defined(__GNUC__) || defined(__clang__)
+     #define NOOB_TARGET_AVX __attribute__ ((target ("avx")))
+    #else
+     #define NOOB_TARGET_AVX
+    #endif
+    NOOB_TARGET_AVX inline float kernelAVX (const float* spec, int size, float* prevMag) {
+        const int half = size / 2; int k = 0;
+        __m256 acc = _mm256_setzero_ps(); const __m256 zero = _mm256_setzero_ps();
+        for (; k + 8 <= half; k += 8) {
+            const __m256 re = _mm256_loadu_ps (spec + k);
+            __m256 im = _mm256_loadu_ps (spec + size - 8 - k);
+            im = _mm256_permute2f128_ps (im, im, 0x01);                    // swap 128-bit halves
+            im = _mm256_shuffle_ps (im, im, _MM_SHUFFLE (0, 1, 2, 3));    // reverse within halves
+            const __m256 m = _mm256_sqrt_ps (_mm256_add_ps (_mm256_mul_ps (re, re), _mm256_mul_ps (im, im)));
+            acc = _mm256_add_ps (acc, _mm256_max_ps (_mm256_sub_ps (m, _mm256_loadu_ps (prevMag + k)), zero));
+            _mm256_storeu_ps (prevMag + k, m);
+        }
+        alignas (32) float lanes[8]; _mm256_store_ps (lanes, acc);
+        float sum = ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) + ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7]));
+        for (; k < half; ++k) {
+            const float re = spec[k], im = spec[size - 1 - k];
+            const float m = std::sqrt (re * re + im * im);
+            const float d = m - prevMag[k]; if (d > 0) sum += d;
+            prevMag[k] = m;
+        }
+        return sum;
+    }
+   #endif
+
+   #if JUCE_USE_ARM_NEON && defined(__aarch64__)
+    inline float kernelNEON (const float* spec, int size, float* prevMag) {
+        const int half = size / 2; int k = 0;
+        float32x4_t acc = vdupq_n_f32 (0.0f); const float32x4_t zero = vdupq_n_f32 (0.0f);
+        for (; k + 4 <= half; k += 4) {
+            const float32x4_t re = vld1q_f32 (spec + k);
+            float32x4_t im = vrev64q_f32 (vld1q_f32 (spec + size - 4 - k));
+            im = vcombine_f32 (vget_high_f32 (im), vget_low_f32 (im));     // full 4-lane reverse
+            const float32x4_t m = vsqrtq_f32 (vaddq_f32 (vmulq_f32 (re, re), vmulq_f32 (im, im)));
+            acc = vaddq_f32 (acc, vmaxq_f32 (vsubq_f32 (m, vld1q_f32 (prevMag + k)), zero));
+            vst1q_f32 (prevMag + k, m);
+        }
+        float sum = vaddvq_f32 (acc);
+        for (; k < half; ++k) {
+            const float re = spec[k], im = spec[size - 1 - k];
+            const float m = std::sqrt (re * re + im * im);
+            const float d = m - prevMag[k]; if (d > 0) sum += d;
+            prevMag[k] = m;
+        }
+        return sum;
+    }
+   #endif
+
+    // Runtime dispatch, resolved once.
+    inline KernelFn get() {
+        static const KernelFn fn = [] () -> KernelFn {
+           #if JUCE_USE_SSE_INTRINSICS
+            if (juce::SystemStats::hasAVX()) return kernelAVX;
+            if (juce::SystemStats::hasSSE2()) return kernelSSE;
+           #endif
+           #if JUCE_USE_ARM_NEON && defined(__aarch64__)
+            return kernelNEON;
+           #endif
+            return kernelScalar;
+        }();
+        return fn;
+    }
+}
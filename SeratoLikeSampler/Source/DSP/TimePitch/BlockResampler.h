@@ -0,0 +1,167 @@
+#pragma once
+#include <juce_core/juce_core.h>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#if JUCE_USE_SSE_INTRINSICS
+ #include <immintrin.h>
+#endif
+#if JUCE_USE_ARM_NEON
+ #include <arm_neon.h>
+#endif
+
+// Windowed-sinc tables and the SIMD dot product for BlockResampler.
+// The table has numPhases rows of taps coefficients (Blackman-windowed sinc, cutoff at
+// 0.92 of the source Nyquist, each row normalised to unity gain); row j interpolates at
+// fraction j / numPhases between sample halfTaps-1 and halfTaps of its taps inputs.
+namespace resample {
+    static constexpr int halfTaps = 8, taps = 2 * halfTaps, phaseBits = 10, numPhases = 1 << phaseBits;
+
+    // Built on first use; BlockResampler::prepare() makes sure that is off the audio thread.
+    inline const float* sincTable() {
+        static const std::vector<float> table = [] {
+            std::vector<float> t ((size_t) (numPhases * taps));
+            const double cut = 0.92, pi = juce::MathConstants<double>::pi;
+            for (int j = 0; j < numPhases; ++j) {
+                const double frac = (double) j / numPhases; double sum = 0.0;
+                for (int k = 0; k < taps; ++k) {
+                    const double x = (double) (k - (halfTaps - 1)) - frac;
+                    const double s = std::abs (x) < 1.0e-9 ? cut : std::sin (pi * cut * x) / (pi * x);
+                    const double w = 0.42 + 0.5 * std::cos (pi * x / halfTaps) + 0.08 * std::cos (2.0 * pi * x / halfTaps);
+                    t[(size_t) (j * taps + k)] = (float) (s * w); sum += s * w;
+                }
+                for (int k = 0; k < taps; ++k) t[(size_t) (j * taps + k)] = (float) (t[(size_t) (j * taps + k)] / sum);
+            }
+            return t;
+        }();
+        return table.data();
+    }
+
+    using DotFn = float (*) (const float* x, const float* h); // taps samples . taps coefficients
+
+    inline float dotScalar (const float* x, const float* h) {
+        float sum = 0.0f;
+        for (int k = 0; k < taps; ++k) sum += x[k] * h[k];
+        return sum;
+    }
+
+   #if JUCE_USE_SSE_INTRINSICS
+    inline float dotSSE (const float* x, const float* h) {
+        __m128 acc = _mm_mul_ps (_mm_loadu_ps (x), _mm_loadu_ps (h));
+        for (int k = 4; k < taps; k += 4)
+            acc = _mm_add_ps (acc, _mm_mul_ps (_mm_loadu_ps (x + k), _mm_loadu_ps (h + k)));
+        alignas (16) float lanes[4]; _mm_store_ps (lanes, acc);
+        return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    }
+   #endif
+
+   #if JUCE_USE_ARM_NEON && defined(__aarch64__)
+    inline float dotNEON (const float* x, const float* h) {
+        float32x4_t acc = vmulq_f32 (vld1q_f32 (x), vld1q_f32 (h));
+        for (int k = 4; k < taps; k += 4) acc = vfmaq_f32 (acc, vld1q_f32 (x + k), vld1q_f32 (h + k));
+        return vaddvq_f32 (acc);
+    }
+   #endif
+
+    // Runtime dispatch, resolved once.
+    inline DotFn getDot() {
+        static const DotFn fn = [] () -> DotFn {
+           #if JUCE_USE_SSE_INTRINSICS
+            if (juce::SystemStats::hasSSE2()) return dotSSE;
+           #endif
+           #if JUCE_USE_ARM_NEON && defined(__aarch64__)
+            return dotNEON;
+           #endif
+            return dotScalar;
+        }();
+        return fn;
+    }
+}
+
+// Streaming resampler for TimePitchEngine's resample backend, one block per call on raw
+// channel pointers. The read position is a 32.32 fixed-point phase carried across calls,
+// along with the last halfTaps input samples, so consecutive blocks join without a seam at
+// any ratio. Interpolation: linear, cubic Hermite (Catmull-Rom) or 16-tap windowed sinc.
+// Past the supplied input (end of file) it reads silence.
+class BlockResampler {
+public:
+    enum class Quality { linear, cubic, sinc };
+    static constexpr int lookahead = resample::halfTaps; // input needed past the last output position
+    // Not on the audio thread: sizes the work buffers for calls of up to maxInput samples.
+    void prepare (int maxInputToUse) {
+        maxInput = juce::jmax (1, maxInputToUse);
+        for (auto& w : work) w.assign ((size_t) (history + maxInput + lookahead + 1), 0.0f);
+        resample::sincTable(); dot = resample::getDot();
+        reset();
+    }
+    void reset() { phase = 0; for (auto& w : work) std::fill (w.begin(), w.begin() + juce::jmin ((int) w.size(), history), 0.0f); }
+    void setQuality (Quality q) { quality = q; }
+    // Input samples per output sample (> 1 = faster/higher).
+    void setRate (double rate) { step = (std::uint64_t) std::llround (juce::jlimit (1.0e-4, 64.0, rate) * one); }
+    // Input samples process() wants so numOut outputs use no padding.
+    int inputFor (int numOut) const { return (int) ((phase + step * (std::uint64_t) numOut) >> 32) + lookahead + 1; }
+    // Writes numOut samples to each of numChannels outputs from up to 'available' input
+    // samples. Returns how many input samples were consumed (the caller advances by that
+    // and passes the following input next time).
+    int process (const float* const* in, int numInChannels, int available, float* const* out, int numChannels, int numOut) {
+        available = juce::jlimit (0, maxInput, available);
+        numChannels = juce::jmin (numChannels, (int) work.size());
+        if (available == 0 || numInChannels <= 0 || numChannels <= 0) return 0;
+        // Outputs whose integer position lands on a supplied sample
+        const std::uint64_t limit = (std::uint64_t) available << 32;
+        const int produced = phase >= limit ? 0 : (int) juce::jmin<std::uint64_t> ((std::uint64_t) numOut, (limit - phase + step - 1) / step);
+        for (int c = 0; c < numChannels; ++c) {
+            float* w = work[(size_t) c].data();
+            std::memcpy (w + history, in[juce::jmin (c, numInChannels - 1)], sizeof (float) * (size_t) available);
+            std::fill (w + history + available, w + history + available + lookahead + 1, 0.0f);
+            render (w + history, out[c], produced);
+            std::fill (out[c] + produced, out[c] + numOut, 0.0f);
+        }
+        phase += step * (std::uint64_t) produced;
+        const int consumed = (int) juce::jmin<std::uint64_t> (phase >> 32, (std::uint64_t) available);
+        phase -= (std::uint64_t) consumed << 32;
+        // Keep the samples just before the new position for the next call's left taps
+        for (int c = 0; c < numChannels; ++c) {
+            float* w = work[(size_t) c].data();
+            std::memmove (w, w + consumed, sizeof (float) * (size_t) history);
+        }
+        return consumed;
+    }
+private:
+    // x[0] is the sample at the integer part of phase; x[-history] .. x[available + lookahead] are valid.
+    void render (const float* x, float* y, int num) const {
+        std::uint64_t p = phase;
+        switch (quality) {
+            case Quality::linear:
+                for (int k = 0; k < num; ++k, p += step) {
+                    const float* s = x + (p >> 32); const float f = (float) (p & fracMask) * toFloat;
+                    y[k] = s[0] + (s[1] - s[0]) * f;
+                }
+                break;
+            case Quality::cubic:
+                for (int k = 0; k < num; ++k, p += step) {
+                    const float* s = x + (p >> 32); const float f = (float) (p & fracMask) * toFloat;
+                    const float c1 = 0.5f * (s[1] - s[-1]);
+                    const float c2 = s[-1] - 2.5f * s[0] + 2.0f * s[1] - 0.5f * s[2];
+                    const float c3 = 0.5f * (s[2] - s[-1]) + 1.5f * (s[0] - s[1]);
+                    y[k] = ((c3 * f + c2) * f + c1) * f + s[0];
+                }
+                break;
+            case Quality::sinc: {
+                const float* table = resample::sincTable();
+                for (int k = 0; k < num; ++k, p += step)
+                    y[k] = dot (x + (p >> 32) - (resample::halfTaps - 1),
+                                table + (size_t) ((p & fracMask) >> (32 - resample::phaseBits)) * resample::taps);
+                break;
+            }
+        }
+    }
+    static constexpr int history = resample::halfTaps;
+    static constexpr std::uint64_t one = (std::uint64_t) 1 << 32, fracMask = one - 1;
+    static constexpr float toFloat = 1.0f / 4294967296.0f;
+    std::array<std::vector<float>, 2> work; int maxInput { 1 };
+    std::uint64_t phase { 0 }, step { one };
+    Quality quality { Quality::cubic }; resample::DotFn dot { resample::dotScalar };
+};
@@ -0,0 +1,80 @@
+#pragma once
+#include <juce_core/juce_core.h>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "BlockResampler.h"
+
+// Offline sample-rate conversion from a random-access source (SamplePool's decoded file)
+// to another rate. Output k sits at source position k * inRate / outRate, computed in
+// integers so slice positions map exactly both ways (toOutput / toInput). 32-tap
+// Blackman-windowed sinc with the cutoff lowered when downsampling (no aliasing), its
+// coefficients interpolated between numPhases rows; the dot products reuse BlockResampler's
+// SIMD kernel. Stateless between calls, so a file can be converted chunk by chunk as it
+// decodes, from a float window of it (inputRange()) rather than the whole file; convert()
+// is realtime-safe and may run on several threads at once.
+class SampleRateConverter {
+public:
+    static constexpr int halfTaps = 2 * resample::halfTaps, taps = 2 * halfTaps, numPhases = 256;
+    // Not on the audio thread: builds the table for this pair of rates.
+    void prepare (int inRateToUse, int outRateToUse) {
+        inRate = juce::jmax (1, inRateToUse); outRate = juce::jmax (1, outRateToUse);
+        const double cut = 0.92 * juce::jmin (1.0, (double) outRate / (double) inRate), pi = juce::MathConstants<double>::pi;
+        table.assign ((size_t) ((numPhases + 1) * taps), 0.0f);
+        for (int j = 0; j <= numPhases; ++j) {
+            const double frac = (double) j / numPhases; double sum = 0.0;
+            for (int k = 0; k < taps; ++k) {
+                const double x = (double) (k - (halfTaps - 1)) - frac;
+                const double s = std::abs (x) < 1.0e-9 ? cut : std::sin (pi * cut * x) / (pi * x);
+                const double w = 0.42 + 0.5 * std::cos (pi * x / halfTaps) + 0.08 * std::cos (2.0 * pi * x / halfTaps);
+                table[(size_t) (j * taps + k)] = (float) (s * w); sum += s * w;
+            }
+            for (int k = 0; k < taps; ++k) table[(size_t) (j * taps + k)] = (float) (table[(size_t) (j * taps + k)] / sum);
+        }
+        dot = resample::getDot();
+    }
+    juce::int64 toOutput (juce::int64 inPos) const { return (inPos * outRate + inRate / 2) / inRate; }
+    juce::int64 toInput (juce::int64 outPos) const { return (outPos * inRate + outRate / 2) / outRate; }
+    juce::int64 outputLength (juce::int64 inLength) const { return (inLength * outRate + inRate - 1) / inRate; }
+    // Source samples (within [0, total)) that the taps of outputs [fromOut, fromOut+numOut) touch.
+    juce::Range<juce::int64> inputRange (juce::int64 fromOut, int numOut, juce::int64 total) const {
+        const juce::int64 first = fromOut * inRate / outRate - (halfTaps - 1);
+        const juce::int64 last  = (fromOut + juce::jmax (1, numOut) - 1) * inRate / outRate + halfTaps + 1;
+        return { juce::jlimit<juce::int64> (0, total, first), juce::jlimit<juce::int64> (0, total, last) };
+    }
+    // Writes outputs [fromOut, ...) of each channel into dst (dst[c][0] is output fromOut),
+    // as far as the first 'available' of the 'total' source samples allow (all of them once
+    // available == total), at most maxOut. Returns how many were written. src[c][0] is source
+    // sample srcStart, and the window must cover inputRange() of the outputs requested.
+    int convert (const float* const* src, juce::int64 srcStart, int numChannels, juce::int64 available, juce::int64 total,
+                 float* const* dst, juce::int64 fromOut, int maxOut) const {
+        const juce::int64 outTotal = outputLength (total);
+        std::array<float, taps> edge;
+        int n = 0;
+        for (juce::int64 k = fromOut; n < maxOut && k < outTotal; ++k, ++n) {
+            const juce::int64 num = k * inRate, i = num / outRate;
+            if (available < total && i + halfTaps >= available) break; // right taps not decoded yet
+            const float phase = (float) (num % outRate) / (float) outRate * (float) numPhases;
+            const int j = juce::jmin (numPhases - 1, (int) phase); const float f = phase - (float) j;
+            const float* h0 = table.data() + (size_t) (j * taps); const float* h1 = h0 + taps;
+            const juce::int64 first = i - (halfTaps - 1);
+            for (int c = 0; c < numChannels; ++c) {
+                const float* x = src[c] + (first - srcStart);
+                if (first < 0 || first + taps > total) {
+                    // Edges: zeros outside the file
+                    for (int t = 0; t < taps; ++t) { const auto p = first + t; edge[(size_t) t] = p >= 0 && p < total ? src[c][p - srcStart] : 0.0f; }
+                    x = edge.data();
+                }
+                const float a = dot (x, h0) + dot (x + resample::taps, h0 + resample::taps);
+                const float b = dot (x, h1) + dot (x + resample::taps, h1 + resample::taps);
+                dst[c][n] = a + (b - a) * f;
+            }
+        }
+        return n;
+    }
+private:
+    juce::int64 inRate { 44100 }, outRate { 44100 };
+    std::vector<float> table; resample::DotFn dot { resample::dotScalar };
+};
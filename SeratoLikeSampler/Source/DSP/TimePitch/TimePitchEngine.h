@@ -1,49 +1,235 @@
 #pragma once
 #include <juce_audio_basics/juce_audio_basics.h>
+#include <array>
+#include <cmath>
+#include <memory>
+#include "BlockResampler.h"
+#if defined(USE_SIGNALSMITH)
+ #include <signalsmith-stretch.h>
+#endif
+#if defined(USE_RUBBERBAND)
+ #include <rubberband/RubberBandStretcher.h>
+#endif
 
-// Minimal scaffold for a time/pitch engine abstraction.
-// Current implementation is a passthrough so it won’t change playback yet.
-// When USE_SIGNALSMITH is defined (CMake option), we can include
-// signalsmith-stretch.hpp and add a backend in a future change.
+// One time/pitch algorithm behind TimePitchEngine. Pull API on non-interleaved stereo: the
+// caller offers up to 'available' input samples, asks for numOut outputs and advances its
+// read position by what process() returns. Everything that allocates is in prepare().
+class TimePitchBackend {
+public:
+    // Most input read per output sample: a slice's own extremes (+24 st at 0.25x time) reach
+    // it, and players clamp anything stacked on top (master key and tempo) to it.
+    static constexpr int maxRate = 16;
+    virtual ~TimePitchBackend() = default;
+    virtual void prepare (double sampleRate, int maxBlock) = 0;
+    // Forget the previous note or stream: no tail, read position back at a whole sample.
+    virtual void reset() = 0;
+    // timeRatio: duration multiplier (2 = half speed); semitones: transposition.
+    virtual void setRatios (double timeRatio, double semitones) = 0;
+    // Input samples consumed per output sample.
+    virtual double getRate() const = 0;
+    // Input samples process() may read to produce numOut samples.
+    virtual int inputFor (int numOut) const = 0;
+    // Writes numOut samples to each output (silence where input ran out); returns input consumed.
+    virtual int process (const float* const* in, int numInChannels, int available, float* const* out, int numChannels, int numOut) = 0;
+    // Streaming use at timeRatio 1 (the master bus): num in, num out, every input consumed.
+    virtual void processStream (const float* const* in, float* const* out, int numChannels, int num) { process (in, numChannels, num, out, numChannels, num); }
+    // Lead-in prime() takes after reset() (no output), and the output delay left after it.
+    virtual int getPrimeLength() const { return 0; }
+    virtual int prime (const float* const*, int, int) { return 0; }
+    virtual int getLatency() const { return 0; }
+    // End of input: writes the output still held back (the tail after the last process()),
+    // numOut samples to each output, silence past it. Once per note; reset() before reuse.
+    virtual void flush (float* const* out, int numChannels, int numOut) {
+        for (int c = 0; c < numChannels; ++c) juce::FloatVectorOperations::clear (out[c], numOut);
+    }
+    // Delay of processStream(), which is never primed.
+    virtual int getStreamLatency() const { return getPrimeLength() + getLatency(); }
+};
 
-class TimePitchEngine {
+// Turntable-style: pitch and time change together through BlockResampler. No latency;
+// Linear, Cubic and Sinc are its qualities.
+class ResampleBackend final : public TimePitchBackend {
 public:
-    void prepare(double sampleRate, int maxChannels) { sr = sampleRate; channels = juce::jmax(1, maxChannels); }
-    void setParams(float semitones, float stretchRatio) {
-        pitchSemitones = semitones; timeStretch = stretchRatio;
+    static constexpr int inputPadding = BlockResampler::lookahead + 4;
+    void prepare (double, int maxBlock) override { resampler.prepare (juce::jmax (1, maxBlock) * maxRate + inputPadding); }
+    void reset() override { resampler.reset(); }
+    void setQuality (BlockResampler::Quality q) { resampler.setQuality (q); }
+    // pow() runs here, once per note, not per block
+    void setRatios (double timeRatio, double semitones) override {
+        rate = std::pow (2.0, semitones / 12.0) / juce::jmax (1.0e-4, timeRatio);
+        resampler.setRate (rate);
+    }
+    double getRate() const override { return rate; }
+    int inputFor (int numOut) const override { return resampler.inputFor (numOut); }
+    int process (const float* const* in, int numInChannels, int available, float* const* out, int numChannels, int numOut) override {
+        return resampler.process (in, numInChannels, available, out, numChannels, numOut);
     }
+private:
+    BlockResampler resampler; double rate { 1.0 };
+};
 
-    // In-place passthrough helper for interleaved buffer sections
-    void processBlock(juce::AudioBuffer<float>& buffer, int startSample, int numSamples) {
-        juce::ignoreUnused(startSample, numSamples);
-        // Passthrough for now. Backend will replace this.
+#if defined(USE_SIGNALSMITH)
+// Signalsmith Stretch: independent pitch and time, always run stereo (mono feeds both).
+class SignalsmithBackend final : public TimePitchBackend {
+public:
+    void prepare (double sampleRate, int) override { ss.presetDefault (2, (float) sampleRate, false); }
+    void reset() override { ss.reset(); }
+    void setRatios (double newTimeRatio, double semitones) override {
+        timeRatio = juce::jmax (1.0e-4, newTimeRatio); ss.setTransposeSemitones ((float) semitones);
+    }
+    double getRate() const override { return 1.0 / timeRatio; }
+    int inputFor (int numOut) const override { return juce::jmax (1, (int) std::round ((double) numOut * getRate())); }
+    int process (const float* const* in, int numInChannels, int available, float* const* out, int numChannels, int numOut) override {
+        const int n = juce::jlimit (0, available, inputFor (numOut));
+        if (n == 0 || numInChannels <= 0) { for (int c = 0; c < numChannels; ++c) juce::FloatVectorOperations::clear (out[c], numOut); return 0; }
+        std::array<const float*, 2> i { in[0], in[juce::jmin (1, numInChannels - 1)] };
+        std::array<float*, 2> o { out[0], out[juce::jmin (1, numChannels - 1)] };
+        ss.process (i.data(), n, o.data(), numOut);
+        return n;
+    }
+    int getPrimeLength() const override { return ss.inputLatency(); }
+    int prime (const float* const* in, int numInChannels, int available) override {
+        const int n = juce::jlimit (0, available, getPrimeLength());
+        if (n == 0 || numInChannels <= 0) return 0;
+        std::array<const float*, 2> i { in[0], in[juce::jmin (1, numInChannels - 1)] };
+        ss.seek (i.data(), n, getRate());
+        return n;
+    }
+    int getLatency() const override { return ss.outputLatency(); }
+    void flush (float* const* out, int numChannels, int numOut) override {
+        // flush() writes its first block and folds the rest back onto the end (-=)
+        TimePitchBackend::flush (out, numChannels, numOut);
+        std::array<float*, 2> o { out[0], out[juce::jmin (1, numChannels - 1)] };
+        ss.flush (o.data(), numOut);
     }
+private:
+    signalsmith::stretch::SignalsmithStretch<float> ss; double timeRatio { 1.0 };
+};
+#endif
 
-    // Non-interleaved IO (for future backends)
-    void process(const float* const* in, float* const* out, int numChannels, int numSamples) {
-        for (int ch = 0; ch < numChannels; ++ch) {
-            const float* src = in[ch];
-            float* dst = out[ch];
-            if (src == nullptr || dst == nullptr) continue;
-            std::memcpy(dst, src, sizeof(float) * (size_t) numSamples);
+#if defined(USE_RUBBERBAND)
+// Rubber Band in real-time mode. It pushes rather than pulls, so process() feeds it until
+// numOut samples are ready or the input runs out.
+class RubberBandBackend final : public TimePitchBackend {
+public:
+    void prepare (double sampleRate, int maxBlock) override {
+        using RB = RubberBand::RubberBandStretcher;
+        maxProcess = juce::jmax (1, maxBlock) * maxRate;
+        rb = std::make_unique<RB> ((size_t) sampleRate, 2, RB::OptionProcessRealTime | RB::OptionPitchHighConsistency);
+        rb->setMaxProcessSize ((size_t) maxProcess);
+    }
+    void reset() override { rb->reset(); }
+    void setRatios (double newTimeRatio, double semitones) override {
+        timeRatio = juce::jmax (1.0e-4, newTimeRatio);
+        rb->setTimeRatio (timeRatio); rb->setPitchScale (std::pow (2.0, semitones / 12.0));
+    }
+    double getRate() const override { return 1.0 / timeRatio; }
+    int inputFor (int numOut) const override { return (int) std::ceil ((double) numOut * getRate()) + (int) rb->getSamplesRequired(); }
+    int process (const float* const* in, int numInChannels, int available, float* const* out, int numChannels, int numOut) override {
+        if (numInChannels <= 0) available = 0;
+        int consumed = 0;
+        while ((int) rb->available() < numOut && consumed < available) {
+            const int n = juce::jmin (available - consumed, maxProcess, juce::jmax (1, (int) rb->getSamplesRequired()));
+            std::array<const float*, 2> i { in[0] + consumed, in[juce::jmin (1, numInChannels - 1)] + consumed };
+            rb->process (i.data(), (size_t) n, false); consumed += n;
         }
+        retrieve (out, numChannels, numOut);
+        return consumed;
+    }
+    void processStream (const float* const* in, float* const* out, int numChannels, int num) override {
+        std::array<const float*, 2> i { in[0], in[juce::jmin (1, numChannels - 1)] };
+        rb->process (i.data(), (size_t) num, false);
+        retrieve (out, numChannels, num);
+    }
+    int getLatency() const override { return (int) rb->getStartDelay(); }
+    void flush (float* const* out, int numChannels, int numOut) override {
+        // The final (empty) process() pushes out everything still buffered
+        std::array<const float*, 2> i { out[0], out[0] };
+        rb->process (i.data(), 0, true);
+        retrieve (out, numChannels, numOut);
     }
-
-    double getSampleRate() const { return sr; }
-    float  getPitchSemitones() const { return pitchSemitones; }
-    float  getTimeStretch() const { return timeStretch; }
-
 private:
-    double sr { 44100.0 };
-    int channels { 2 };
-    float pitchSemitones { 0.0f }; // +12 = up an octave
-    float timeStretch { 1.0f };    // 1.0 = native speed; 0.5 = half-time
+    void retrieve (float* const* out, int numChannels, int numOut) {
+        const int got = juce::jlimit (0, numOut, (int) rb->available());
+        std::array<float*, 2> o { out[0], out[juce::jmin (1, numChannels - 1)] };
+        if (got > 0) rb->retrieve (o.data(), (size_t) got);
+        for (int c = 0; c < numChannels; ++c) juce::FloatVectorOperations::clear (out[c] + got, numOut - got);
+    }
+    std::unique_ptr<RubberBand::RubberBandStretcher> rb; double timeRatio { 1.0 }; int maxProcess { 1 };
 };
-
-#if defined(USE_SIGNALSMITH)
-// Placeholder include (not used yet). In a follow-up, we’ll add a concrete
-// backend which wraps signalsmith-stretch processing while keeping this
-// interface stable.
-// #include <signalsmith-stretch.hpp>
 #endif
 
+// Time/pitch processing with the backend chosen at runtime. prepare() builds every backend
+// compiled in (USE_SIGNALSMITH, USE_RUBBERBAND), so switching never allocates; a backend
+// that isn't built falls back to the resampler. Pick per quality/CPU budget: resample is
+// cheapest and latency-free but ties pitch to speed, Signalsmith and Rubber Band keep them
+// independent at the cost of CPU and latency.
+class TimePitchEngine {
+public:
+    enum class Backend { resample, signalsmith, rubberband };
+    TimePitchEngine() = default;
+    TimePitchEngine (const TimePitchEngine&) = delete;            // 'active' points into this
+    TimePitchEngine& operator= (const TimePitchEngine&) = delete;
+    static constexpr int maxRate = TimePitchBackend::maxRate;
+    static constexpr int inputPadding = ResampleBackend::inputPadding;
+    static bool isAvailable (Backend b) {
+        switch (b) {
+           #if defined(USE_SIGNALSMITH)
+            case Backend::signalsmith: return true;
+           #endif
+           #if defined(USE_RUBBERBAND)
+            case Backend::rubberband: return true;
+           #endif
+            case Backend::resample: return true;
+            default: return false;
+        }
+    }
+    // Not on the audio thread.
+    void prepare (double sampleRate, int maxBlock) {
+        resampler.prepare (sampleRate, maxBlock);
+       #if defined(USE_SIGNALSMITH)
+        signalsmith = std::make_unique<SignalsmithBackend>(); signalsmith->prepare (sampleRate, maxBlock);
+       #endif
+       #if defined(USE_RUBBERBAND)
+        rubberband = std::make_unique<RubberBandBackend>(); rubberband->prepare (sampleRate, maxBlock);
+       #endif
+        setBackend (backend);
+    }
+    // Takes effect immediately; callers switch between notes (then reset()) or accept a seam.
+    void setBackend (Backend b) {
+        backend = b; active = &resampler;
+        if (b == Backend::signalsmith && signalsmith != nullptr) active = signalsmith.get();
+        if (b == Backend::rubberband && rubberband != nullptr)   active = rubberband.get();
+        active->setRatios (timeRatio, semitones);
+    }
+    Backend getBackend() const { return backend; }
+    // Interpolation of the resample backend.
+    void setQuality (BlockResampler::Quality q) { resampler.setQuality (q); }
+    void setRatios (float newTimeRatio, float newSemitones) {
+        timeRatio = newTimeRatio; semitones = newSemitones;
+        active->setRatios (timeRatio, semitones);
+    }
+    void reset() { active->reset(); }
+    double getRate() const { return active->getRate(); }
+    int inputFor (int numOut) const { return active->inputFor (numOut); }
+    int process (const float* const* in, int numInChannels, int available, float* const* out, int numChannels, int numOut) {
+        if (numOut <= 0 || numChannels <= 0) return 0;
+        return active->process (in, numInChannels, juce::jmax (0, available), out, juce::jmin (numChannels, 2), numOut);
+    }
+    void processStream (const float* const* in, float* const* out, int numChannels, int num) {
+        if (num > 0 && numChannels > 0) active->processStream (in, out, juce::jmin (numChannels, 2), num);
+    }
+    int getPrimeLength() const { return active->getPrimeLength(); }
+    int prime (const float* const* in, int numInChannels, int available) { return active->prime (in, numInChannels, available); }
+    int getLatency() const { return active->getLatency(); }
+    int getStreamLatency() const { return active->getStreamLatency(); }
+    void flush (float* const* out, int numChannels, int numOut) {
+        if (numOut > 0 && numChannels > 0) active->flush (out, juce::jmin (numChannels, 2), numOut);
+    }
+private:
+    ResampleBackend resampler;
+    std::unique_ptr<TimePitchBackend> signalsmith, rubberband;
+    TimePitchBackend* active { &resampler };
+    Backend backend { Backend::signalsmith };
+    double timeRatio { 1.0 }, semitones { 0.0 };
+};
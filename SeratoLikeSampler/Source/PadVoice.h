@@ -3,7 +3,19 @@
 #include <juce_audio_basics/juce_audio_basics.h>
 #include <juce_audio_processors/juce_audio_processors.h>
 #include <juce_dsp/juce_dsp.h>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <vector>
 #include "TimeStretch.h"
+#include "SamplePool.h"
+
+// A slice pre-rendered with its pitch/time/reverse applied (SliceRenderer): stereo,
+// played forward from the start like a plain sample.
+struct SliceRender {
+    juce::AudioBuffer<float> audio;
+    mutable std::atomic<int> users { 0 }; // voices playing it; counted by the audio thread
+};
 
 struct PadSlice {
     int startSample = 0;
@@ -13,75 +25,316 @@ struct PadSlice {
     float pitchSemitones { 0.0f }; // per-pad pitch shift in semitones
     float timeRatio { 1.0f };      // per-pad time stretch ratio (1.0 = normal)
     bool reverse { false };        // play slice backwards
+    int chokeGroup { 0 };          // 0 = none, else 1..maxChokeGroups: a note-on fades its group
+    const SliceRender* rendered { nullptr }; // set in published slice tables once the render is ready
+    const SamplePool* source { nullptr };    // file it plays; nullptr = the engine's current file
+    static constexpr int maxChokeGroups = 8;
 };
 
-class PadVoice {
+// All pad voices, sized in prepare(). Per-sample state (play position, envelope, lowpass
+// state, gains) lives in one array per field, so the render loop walks contiguous memory;
+// stretchers are pooled and the read scratch is shared (16x a block, sized once). Voices
+// at the original pitch and speed read the source straight into the filter and mix,
+// skipping the stretcher and the copy, and so do voices whose slice has a finished render.
+// Stages at identity are skipped too: the lowpass while the cutoff is fully open (switched
+// in and out with a short crossfade) and the envelope in sustain, so a plain voice is one
+// gain-scaled add from the source.
+// Stretchers come from a pool configured in prepare(): a pitched/stretched note takes
+// one, resets it and primes it with the slice's lead-in. When the pool runs low the oldest
+// stretched note fades out to hand its stretcher on, so a note is never dropped. The
+// selected backend's output latency (getLatency(); 0 with the resampler) is applied to
+// every other voice as a start delay, so all voices stay aligned and the host compensates
+// the whole engine. Envelope: linear attack, full sustain, linear release (juce::ADSR with
+// no decay). Filter: TPT state-variable lowpass, as in juce::dsp.
+class PadVoiceBank {
 public:
-    void prepare (double sampleRate, int blockSize) {
+    static constexpr int minVoices = 8, maxVoices = 320, maxStretchers = 64;
+    // Not on the audio thread: allocates every array for numVoices, and the stretcher pool.
+    void prepare (double sampleRate, int blockSize, int numVoices) {
         sr = sampleRate;
-        adsr.setSampleRate (sampleRate);
-        juce::dsp::ProcessSpec spec { sampleRate, (juce::uint32) blockSize, 2 };
-        lp.reset(); lp.prepare (spec);
-        lp.setType (juce::dsp::StateVariableTPTFilterType::lowpass);
-        lp.setCutoffFrequency (12000.0f);
-        lp.setResonance (0.7f);
-        stretcher.prepare (sampleRate, blockSize);
-        temp.setSize (2, 1);
+        maxBlock = juce::jmax (1, blockSize);
+        const auto n = (size_t) juce::jlimit (minVoices, maxVoices, numVoices);
+        sources.assign (n, nullptr); rendered.assign (n, nullptr);
+        pos.assign (n, 0); startPos.assign (n, 0); endPos.assign (n, 0);
+        active.assign (n, 0); reverse.assign (n, 0); stretched.assign (n, 0); stage.assign (n, idle);
+        env.assign (n, 0.0f); releaseStep.assign (n, 0.0f); sliceGain.assign (n, 1.0f); level.assign (n, 0.0f);
+        fadeLeft.assign (n, 0); delayLeft.assign (n, 0); stretcherOf.assign (n, -1); startedAt.assign (n, 0);
+        for (auto* s : { &s1, &s2 }) for (auto& c : *s) c.assign (n, 0.0f);
+        // Streamed sources decode into this; start() keeps every note within maxRate
+        input.prepare (maxBlock * TimeStretcher::maxRate + TimeStretcher::inputPadding);
+        // Fewer stretchers than voices: most notes are plain or play a pre-rendered slice
+        const int numStretchers = juce::jmin ((int) n, maxStretchers);
+        stretchers = std::make_unique<TimeStretcher[]> ((size_t) numStretchers); freeStretchers.clear();
+        for (int k = numStretchers; --k >= 0;) { stretchers[(size_t) k].prepare (sampleRate, blockSize); freeStretchers.push_back (k); }
+        for (auto b : { TimePitchEngine::Backend::resample, TimePitchEngine::Backend::signalsmith, TimePitchEngine::Backend::rubberband }) {
+            stretchers[0].setBackend (b); backendLatency[(size_t) b] = stretchers[0].getLatency();
+        }
+        setBackend (backend);
+        // Scratch sized once for the largest block; voices render one at a time in chunks of this size
+        temp.setSize (2, maxBlock); envelope.assign ((size_t) maxBlock, 0.0f);
+        fadeLength = juce::jmax (1, (int) std::round (sampleRate * fadeSeconds));
+        setParams (attackSeconds, releaseSeconds, cutoffHz, resonance, gainDb);
     }
-    void setParams (float attack, float release, float cutoff, float reso, float gainDb) {
-        juce::ADSR::Parameters p; p.attack = attack; p.decay = 0.0f; p.sustain = 1.0f; p.release = release;
-        adsr.setParameters (p);
-        lp.setCutoffFrequency (cutoff);
-        lp.setResonance (reso);
+    int size() const { return (int) active.size(); }
+    // Output delay of every voice with the selected backend, in samples (what the engine
+    // reports to the host). Any thread.
+    int getLatency() const { return latency.load(); }
+    // Interpolation for pitched/stretched voices on the resampling path; applies from the next note.
+    void setResampleQuality (BlockResampler::Quality q) { resampleQuality = q; }
+    // Time/pitch backend for the next notes (resampler if it isn't built).
+    void setBackend (TimePitchEngine::Backend b) { backend = b; latency.store (backendLatency[(size_t) b]); }
+    // Master key (semitones) and speed applied on top of each slice's own, from the next note.
+    void setMasterKeyTempo (float semitones, float speed) { masterSemitones = semitones; masterSpeed = juce::jmax (0.01f, speed); }
+    void setParams (float attack, float release, float cutoff, float reso, float newGainDb) {
+        attackSeconds = attack; releaseSeconds = release; cutoffHz = cutoff; resonance = reso; gainDb = newGainDb;
+        filterTarget = cutoff < filterOpenHz ? 1.0f : 0.0f;
+        attackStep = attack > 0.0f ? (float) (1.0 / (attack * sr)) : 1.0f;
+        const double g = std::tan (juce::MathConstants<double>::pi * juce::jmin ((double) cutoff, sr * 0.49) / sr);
+        const double r2 = 1.0 / juce::jmax (0.01, (double) reso);
+        svfG = (float) g; svfR2 = (float) r2; svfH = (float) (1.0 / (1.0 + r2 * g + g * g));
         gainLin = juce::Decibels::decibelsToGain (gainDb);
     }
-    void startNote (const juce::AudioBuffer<float>& src, const PadSlice& slice) {
-        source = &src; current = slice; pos = current.reverse ? current.endSample : current.startSample; adsr.noteOn(); active = true; sliceGainLin = current.gainLin;
-        // Configure stretcher for this note
-        stretcher.setRatios (current.timeRatio, current.pitchSemitones, false);
+    void start (int v, const SamplePool& src, const PadSlice& slice) {
+        const auto i = (size_t) v;
+        deactivate (i);
+        // Slices are in file samples; voices run in playback (host-rate) samples
+        sources[i] = &src; src.addVoice(); startPos[i] = src.toPlayback (slice.startSample); endPos[i] = src.toPlayback (slice.endSample);
+        reverse[i] = slice.reverse; pos[i] = slice.reverse ? endPos[i] : startPos[i];
+        // Only voices that change pitch or speed go through the stretcher, in either direction
+        float semis = slice.pitchSemitones + masterSemitones, timeRatio = slice.timeRatio / masterSpeed;
+        if (masterSemitones != 0.0f || masterSpeed != 1.0f) {
+            // The master offsets can push a slice past maxRate (input read per output sample),
+            // which the stretchers and read scratch are sized for: clamp time, then pitch
+            constexpr float maxRate = (float) TimeStretcher::maxRate;
+            timeRatio = juce::jlimit (1.0f / maxRate, maxRate, timeRatio);
+            semis = juce::jlimit (12.0f * std::log2 (timeRatio / maxRate), 12.0f * std::log2 (timeRatio * maxRate), semis);
+        }
+        stretched[i] = timeRatio != 1.0f || semis != 0.0f;
+        // Renders are made at the slice's own settings, so only without a master offset
+        if (slice.rendered != nullptr && masterSemitones == 0.0f && masterSpeed == 1.0f) {
+            // Pitch, time and reverse are baked in: read the render from its start
+            rendered[i] = slice.rendered; rendered[i]->users.fetch_add (1);
+            startPos[i] = pos[i] = 0; endPos[i] = slice.rendered->audio.getNumSamples();
+            reverse[i] = stretched[i] = 0;
+        }
+        delayLeft[i] = latency.load();
+        if (stretched[i]) {
+            stretcherOf[i] = takeStretcher();
+            auto& st = stretchers[(size_t) stretcherOf[i]];
+            st.setBackend (backend); st.setQuality (resampleQuality); st.setRatios (timeRatio, semis); st.reset();
+            // Lead-in: the stretcher's input latency, so output starts getLatency() after the note
+            const juce::int64 room = reverse[i] ? pos[i] : src.getPlaybackLength() - pos[i];
+            const int lead = (int) juce::jmin<juce::int64> (room, st.getPrimeLength(), input.capacity());
+            if (lead > 0) {
+                const float* const* in = reverse[i] ? src.getReversedReadPointers (pos[i], lead, input)
+                                                    : src.getReadPointers (pos[i], lead, input);
+                const int consumed = st.prime (in, 2, lead);
+                pos[i] += reverse[i] ? -consumed : consumed;
+            }
+            // The stretcher's own output latency is part of the delay
+            delayLeft[i] = juce::jmax (0, delayLeft[i] - st.getLatency());
+        }
+        stage[i] = attack; env[i] = 0.0f; fadeLeft[i] = 0; active[i] = 1; startedAt[i] = ++notesStarted;
+        sliceGain[i] = slice.gainLin; level[i] = gainLin * slice.gainLin;
+        for (auto* s : { &s1, &s2 }) for (auto& c : *s) c[i] = 0.0f;
+    }
+    // Note-off: release from the current envelope level.
+    void stop (int v) {
+        const auto i = (size_t) v;
+        if (stage[i] == idle || stage[i] == release) return;
+        stage[i] = release;
+        releaseStep[i] = releaseSeconds > 0.0f ? env[i] / (float) (releaseSeconds * sr) : 1.0f;
+    }
+    // Short linear fade to silence for stolen and choked voices (no click, unlike kill()).
+    void fadeOut (int v) { if (active[(size_t) v] && fadeLeft[(size_t) v] == 0) fadeLeft[(size_t) v] = fadeLength; }
+    void killAll() { for (size_t i = 0; i < active.size(); ++i) deactivate (i); }
+    bool isActive (int v) const { return active[(size_t) v] != 0; }
+    // Peak output of the last rendered chunk; what the quietest-voice steal compares.
+    float getLevel (int v) const { return level[(size_t) v]; }
+    // Read position in the source, or -1 for voices playing a render.
+    juce::int64 getPosition (int v) const { return rendered[(size_t) v] != nullptr ? -1 : pos[(size_t) v]; }
+    // Voice v's read-ahead play head on its source (slot 0 is the engine's preview).
+    static int playHeadOf (size_t i) { return 1 + (int) i; }
+    // Tells a streamed source where voice v reads, so its read-ahead stays in front.
+    void publishPlayHead (int v) const {
+        const auto i = (size_t) v;
+        if (active[i] && sources[i] != nullptr && sources[i]->isStreaming()) sources[i]->setPlayHead (playHeadOf (i), getPosition (v));
+    }
+    // Mixes the listed voices into [startSample, startSample+numSamples) of out. Voices that
+    // finish are left inactive for the caller to free.
+    void render (juce::AudioBuffer<float>& out, int startSample, int numSamples, const int* voices, int numVoices) {
+        // Hosts may exceed the prepared block size; never grow the scratch buffers here
+        while (numSamples > 0) {
+            const int n = juce::jmin (numSamples, maxBlock);
+            // Filter wet amount ramps over fadeLength when the cutoff opens or closes
+            const float wetStart = filterWet;
+            filterWet = filterTarget > filterWet ? juce::jmin (filterTarget, filterWet + (float) n / (float) fadeLength)
+                                                 : juce::jmax (filterTarget, filterWet - (float) n / (float) fadeLength);
+            for (int k = 0; k < numVoices; ++k)
+                if (active[(size_t) voices[k]]) renderChunk (voices[k], out, startSample, n, wetStart, filterWet);
+            startSample += n; numSamples -= n;
+        }
     }
-    void stopNote() { adsr.noteOff(); }
-    void kill() { active = false; }
-    bool isActive() const { return active; }
-    bool isPlayingMidi (int midiNote) const { return active && current.midiNote == midiNote; }
-    void render (juce::AudioBuffer<float>& out, int startSample, int numSamples) {
-        if (! active || source == nullptr) return;
-        temp.setSize (out.getNumChannels(), numSamples, false, true, true); temp.clear();
-        const int sliceLength = juce::jmax (0, current.endSample - current.startSample);
-        const int remaining = current.reverse ? juce::jmax (0, pos - current.startSample) : juce::jmax (0, current.endSample - pos);
-        const int toCopy = juce::jlimit (0, numSamples, remaining);
+private:
+    enum Stage : unsigned char { idle, attack, sustain, release };
+    void renderChunk (int v, juce::AudioBuffer<float>& out, int startSample, int numSamples, float wetStart, float wetEnd) {
+        const auto i = (size_t) v;
+        const SamplePool* source = sources[i];
+        if (source == nullptr) { deactivate (i); return; }
+        if (delayLeft[i] > 0) {
+            // Waiting out the backend latency so this voice lines up with stretched ones
+            const int skip = juce::jmin (delayLeft[i], numSamples);
+            delayLeft[i] -= skip; startSample += skip; numSamples -= skip;
+            if (numSamples == 0) return;
+        }
+        const juce::int64 remaining = reverse[i]    ? pos[i] - startPos[i]
+                                    : rendered[i] ? endPos[i] - pos[i]
+                                                  : juce::jmin<juce::int64> (endPos[i], source->getPlaybackLength()) - pos[i];
+        const int toCopy = (int) juce::jlimit<juce::int64> (0, numSamples, remaining);
+        std::array<const float*, 2> in { temp.getReadPointer (0), temp.getReadPointer (1) };
         if (toCopy > 0) {
-            if (current.reverse) {
-                // Copy reversed samples into temp
-                temp.clear();
-                for (int ch = 0; ch < temp.getNumChannels(); ++ch) {
-                    const int srcCh = juce::jmin (ch, source->getNumChannels()-1);
-                    for (int i = 0; i < toCopy; ++i) {
-                        int srcIndex = juce::jlimit (current.startSample, current.endSample - 1, pos - 1 - i);
-                        temp.setSample (ch, i, source->getSample (srcCh, srcIndex));
-                    }
-                }
-                pos -= toCopy;
+            if (rendered[i] != nullptr) {
+                const auto& audio = rendered[i]->audio;
+                in = { audio.getReadPointer (0, (int) pos[i]), audio.getReadPointer (1, (int) pos[i]) };
+                pos[i] += toCopy;
+            } else if (stretched[i]) {
+                // Stretcher returns input consumed. It may read past the slice end (before its
+                // start in reverse), but never past either end of the file. Reverse reads a
+                // reversed block, so the stretcher always runs forward.
+                auto& st = stretchers[(size_t) stretcherOf[i]];
+                const juce::int64 room = reverse[i] ? pos[i] : source->getPlaybackLength() - pos[i];
+                const int available = (int) juce::jmin<juce::int64> (room, st.inputFor (toCopy), input.capacity());
+                const float* const* src = reverse[i] ? source->getReversedReadPointers (pos[i], available, input)
+                                                     : source->getReadPointers (pos[i], available, input);
+                const int consumed = st.process (src, 2, available, toCopy, temp);
+                pos[i] += reverse[i] ? -consumed : consumed;
+            } else if (reverse[i]) {
+                const float* const* src = source->getReversedReadPointers (pos[i], toCopy, input);
+                in = { src[0], src[1] };
+                pos[i] -= toCopy;
             } else {
-                // Forward playback: process via stretcher (returns input consumed)
-                int consumed = stretcher.process (*source, pos, toCopy, temp);
-                pos += consumed;
+                const float* const* src = source->getReadPointers (pos[i], toCopy, input);
+                in = { src[0], src[1] };
+                pos[i] += toCopy;
             }
         }
-        adsr.applyEnvelopeToBuffer (temp, 0, numSamples);
-        juce::dsp::AudioBlock<float> blk (temp);
-        juce::dsp::ProcessContextReplacing<float> ctx (blk);
-        lp.process (ctx);
-        for (int ch = 0; ch < out.getNumChannels(); ++ch)
-            out.addFrom (ch, startSample, temp, ch, 0, numSamples, gainLin * sliceGainLin);
-        const bool reachedEnd = current.reverse ? (pos <= current.startSample) : (pos >= current.endSample);
-        if (reachedEnd || ! adsr.isActive()) active = false;
+        bool flat = false;
+        const int n = fillEnvelope (i, toCopy, flat);
+        const float gain = gainLin * sliceGain[i];
+        if (n > 0 && wetStart == 0.0f && wetEnd == 0.0f) {
+            // Filter open: straight from the input, scaled by the gain (and envelope unless flat)
+            float* e = envelope.data();
+            if (! flat) juce::FloatVectorOperations::multiply (e, gain, n);
+            for (int ch = 0; ch < out.getNumChannels(); ++ch) {
+                const float* x = in[(size_t) juce::jmin (ch, 1)];
+                if (flat) out.addFrom (ch, startSample, x, n, gain);
+                else      juce::FloatVectorOperations::addWithMultiply (out.getWritePointer (ch, startSample), x, e, n);
+            }
+            float peak = 0.0f;
+            for (const float* x : in) { const auto r = juce::FloatVectorOperations::findMinAndMax (x, n); peak = juce::jmax (peak, -r.getStart(), r.getEnd()); }
+            level[i] = peak * (flat ? gain : e[n - 1]);
+        } else if (n > 0) {
+            // Lowpass and envelope into temp (in place for voices that rendered into it),
+            // crossfaded with the dry input while the filter switches in or out
+            const float g = svfG, r2 = svfR2, h = svfH, wetStep = (wetEnd - wetStart) / (float) n;
+            for (int ch = 0; ch < 2; ++ch) {
+                const float* x = in[(size_t) ch]; float* y = temp.getWritePointer (ch);
+                // Coming back from bypass: start the integrators from rest, under the fade
+                float a = wetStart == 0.0f ? 0.0f : s1[(size_t) ch][i], b = wetStart == 0.0f ? 0.0f : s2[(size_t) ch][i];
+                for (int k = 0; k < n; ++k) {
+                    const float hp = h * (x[k] - a * (g + r2) - b);
+                    const float bp = hp * g + a; a = hp * g + bp;
+                    const float lp = bp * g + b; b = bp * g + lp;
+                    const float wet = wetStart + wetStep * (float) k;
+                    y[k] = (x[k] + (lp - x[k]) * wet) * (flat ? 1.0f : envelope[(size_t) k]);
+                }
+                s1[(size_t) ch][i] = a; s2[(size_t) ch][i] = b;
+            }
+            for (int ch = 0; ch < out.getNumChannels(); ++ch)
+                out.addFrom (ch, startSample, temp, juce::jmin (ch, 1), 0, n, gain);
+            level[i] = temp.getMagnitude (0, n) * gain;
+        }
+        const bool reachedEnd = reverse[i] ? (pos[i] <= startPos[i]) : (pos[i] >= endPos[i]);
+        if (reachedEnd || stage[i] == idle || toCopy == 0) deactivate (i);
     }
-private:
-    const juce::AudioBuffer<float>* source { nullptr };
-    PadSlice current; int pos { 0 }; double sr { 44100.0 }; bool active { false };
-    juce::ADSR adsr;
-    juce::dsp::StateVariableTPTFilter<float> lp;
-    float gainLin { 1.0f }; float sliceGainLin { 1.0f };
-    TimeStretcher stretcher; juce::AudioBuffer<float> temp;
+    // A free stretcher. Below the reserve the oldest stretched note starts its fade, so one
+    // comes back within fadeLength; a burst faster than that cuts the oldest fading note short.
+    int takeStretcher() {
+        if (freeStretchers.empty()) {
+            const int v = oldestStretched (true);
+            jassert (v >= 0); // an empty pool means every stretcher is on a sounding voice
+            deactivate ((size_t) v);
+        }
+        const int k = freeStretchers.back(); freeStretchers.pop_back();
+        if ((int) freeStretchers.size() < stretcherReserve)
+            if (const int v = oldestStretched (false); v >= 0) fadeOut (v);
+        return k;
+    }
+    // Oldest voice holding a stretcher: among those already fading if fading (falling back to
+    // any), else among those not fading yet. -1 if none.
+    int oldestStretched (bool fading) const {
+        int best = -1, any = -1;
+        for (size_t i = 0; i < active.size(); ++i) {
+            if (! active[i] || stretcherOf[i] < 0) continue;
+            if (any < 0 || startedAt[i] < startedAt[(size_t) any]) any = (int) i;
+            if ((fadeLeft[i] > 0) == fading && (best < 0 || startedAt[i] < startedAt[(size_t) best])) best = (int) i;
+        }
+        return best >= 0 || ! fading ? best : any;
+    }
+    void deactivate (size_t i) {
+        active[i] = 0;
+        if (stretcherOf[i] >= 0) { freeStretchers.push_back (stretcherOf[i]); stretcherOf[i] = -1; }
+        if (rendered[i] != nullptr) { rendered[i]->users.fetch_sub (1); rendered[i] = nullptr; }
+        if (sources[i] != nullptr) { sources[i]->setPlayHead (playHeadOf (i), -1); sources[i]->removeVoice(); sources[i] = nullptr; }
+    }
+    // Envelope (times any steal/choke fade) for the next num samples into 'envelope'.
+    // Returns how many of them are audible: fewer than num once the voice falls silent.
+    // A voice in sustain with no fade leaves 'envelope' alone and sets flat instead.
+    int fillEnvelope (size_t i, int num, bool& flat) {
+        flat = stage[i] == sustain && fadeLeft[i] == 0;
+        if (flat) return num;
+        float* e = envelope.data(); float lvl = env[i]; int k = 0;
+        if (stage[i] == attack) {
+            for (; k < num && lvl < 1.0f; ++k) e[k] = lvl = juce::jmin (1.0f, lvl + attackStep);
+            if (lvl >= 1.0f) stage[i] = sustain;
+        }
+        if (stage[i] == sustain) {
+            std::fill (e + k, e + num, 1.0f);
+        } else if (stage[i] == release) {
+            const float step = releaseStep[i];
+            for (; k < num && lvl > 0.0f; ++k) e[k] = lvl = juce::jmax (0.0f, lvl - step);
+            if (lvl <= 0.0f) { stage[i] = idle; num = k; }
+        } else if (stage[i] == idle) {
+            num = k;
+        }
+        env[i] = lvl;
+        if (fadeLeft[i] > 0) {
+            const int f = fadeLeft[i], m = juce::jmin (num, f);
+            for (int j = 0; j < m; ++j) e[j] *= (float) (f - j - 1) / (float) fadeLength;
+            fadeLeft[i] = f - m;
+            if (fadeLeft[i] == 0) { stage[i] = idle; num = m; }
+        }
+        return num;
+    }
+    static constexpr double fadeSeconds = 0.005;
+    static constexpr int stretcherReserve = 4; // free stretchers kept for notes arriving during a steal fade
+    double sr { 44100.0 }; int maxBlock { 512 }; int fadeLength { 220 };
+    float attackSeconds { 0.01f }, releaseSeconds { 0.2f }, cutoffHz { 12000.0f }, resonance { 0.7f }, gainDb { 0.0f };
+    float attackStep { 1.0f }, svfG { 0.0f }, svfR2 { 1.0f }, svfH { 1.0f }, gainLin { 1.0f };
+    static constexpr float filterOpenHz = 18000.0f; // the cutoff parameter's top: filter bypassed
+    float filterTarget { 1.0f }, filterWet { 1.0f }; BlockResampler::Quality resampleQuality { BlockResampler::Quality::cubic };
+    TimePitchEngine::Backend backend { TimePitchEngine::Backend::signalsmith }; float masterSemitones { 0.0f }, masterSpeed { 1.0f };
+    // Per-voice state, indexed by voice
+    std::vector<const SamplePool*> sources; std::vector<const SliceRender*> rendered;
+    std::vector<juce::int64> pos, startPos, endPos;
+    std::vector<unsigned char> active, reverse, stretched; std::vector<Stage> stage;
+    std::vector<float> env, releaseStep, sliceGain, level; std::vector<int> fadeLeft;
+    std::array<std::vector<float>, 2> s1, s2; // lowpass integrator state per channel
+    std::vector<int> delayLeft, stretcherOf; // stretcherOf: pool index, -1 = none
+    std::vector<juce::uint64> startedAt; juce::uint64 notesStarted { 0 }; // note-on order, for stealing stretchers
+    // Stretcher pool; freeStretchers never outgrows its prepare() capacity
+    std::unique_ptr<TimeStretcher[]> stretchers; std::vector<int> freeStretchers;
+    std::array<int, 3> backendLatency {}; std::atomic<int> latency { 0 }; // per Backend, and the selected one's
+    // Shared scratch: one voice renders (or starts) at a time
+    juce::AudioBuffer<float> temp; std::vector<float> envelope; SampleReadScratch input;
 };
@@ -13,9 +13,21 @@ inline juce::AudioProcessorValueTreeState::ParameterLayout createLayout() {
     p.push_back (std::make_unique<AudioParameterInt>("basenote","Base Note", 0, 127, 36));
     p.push_back (std::make_unique<AudioParameterInt>("maxslices","Max Slices", 1, 128, 64));
     p.push_back (std::make_unique<AudioParameterFloat>("sensitivity","Sensitivity", NormalisableRange<float>(0.6f, 2.0f, 0, 1.0f), 1.2f));
+    p.push_back (std::make_unique<AudioParameterChoice>("threshmode","Threshold Mode", StringArray { "Mean", "Median" }, 0));
     p.push_back (std::make_unique<AudioParameterFloat>("mingapms","Min Gap (ms)", NormalisableRange<float>(1.f, 500.f, 1.f), 30.f));
     // Playback behaviour
     p.push_back (std::make_unique<AudioParameterBool>("choke","Choke (Mono)", false));
     p.push_back (std::make_unique<AudioParameterBool>("gate","Gate", false));
+    // Voice count; takes effect when the host next prepares the plugin
+    p.push_back (std::make_unique<AudioParameterInt>("voices","Voices", 8, 256, 32));
+    p.push_back (std::make_unique<AudioParameterChoice>("interp","Repitch Quality", StringArray { "Linear", "Cubic", "Sinc" }, 1));
+    // Time/pitch backend for pitched and stretched pads (unbuilt ones fall back to Resample)
+    p.push_back (std::make_unique<AudioParameterChoice>("tpengine","Time/Pitch Engine", StringArray { "Resample", "Signalsmith", "Rubber Band" }, 1));
+    p.push_back (std::make_unique<AudioParameterInt>("masterkey","Master Key", -12, 12, 0));
+    p.push_back (std::make_unique<AudioParameterFloat>("mastertempo","Master Tempo", NormalisableRange<float>(0.5f, 2.0f, 0.01f, 0.5f), 1.0f));
+    p.push_back (std::make_unique<AudioParameterChoice>("keymode","Master Key Mode", StringArray { "Per Voice", "Master Bus" }, 0));
+    // Memory format of loaded samples; takes effect on the next load
+    p.push_back (std::make_unique<AudioParameterChoice>("storage","Sample Storage", StringArray { "Float", "Native", "Compact 16-bit" }, 1));
+    p.push_back (std::make_unique<AudioParameterChoice>("steal","Voice Steal", StringArray { "Oldest", "Quietest", "Same Note" }, 0));
     return { p.begin(), p.end() };
   }}
@@ -0,0 +1,135 @@
+#pragma once
+#include <juce_core/juce_core.h>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#if JUCE_USE_SSE_INTRINSICS
+ #include <emmintrin.h>
+#endif
+#if JUCE_USE_ARM_NEON
+ #include <arm_neon.h>
+#endif
+
+// Integer PCM <-> float block conversion for PcmBuffer. Reads run on the audio thread
+// (int16 through SIMD, resolved once); writes are offline (decode, sample-rate conversion).
+namespace pcm {
+    enum class Format { float32, int16, int24 }; // int24: packed, 3 bytes little-endian
+    inline int bytesPerSample (Format f) { return f == Format::int16 ? 2 : f == Format::int24 ? 3 : 4; }
+
+    using Int16ToFloatFn = void (*) (float* dest, const int16_t* src, int num);
+
+    inline void int16ToFloatScalar (float* dest, const int16_t* src, int num) {
+        for (int k = 0; k < num; ++k) dest[k] = (float) src[k] * (1.0f / 32768.0f);
+    }
+
+   #if JUCE_USE_SSE_INTRINSICS
+    inline void int16ToFloatSSE (float* dest, const int16_t* src, int num) {
+        const __m128 scale = _mm_set1_ps (1.0f / 32768.0f);
+        int k = 0;
+        for (; k + 8 <= num; k += 8) {
+            const __m128i v = _mm_loadu_si128 (reinterpret_cast<const __m128i*> (src + k));
+            // Sign-extend by unpacking each sample into the top half of a 32-bit lane
+            const __m128i lo = _mm_srai_epi32 (_mm_unpacklo_epi16 (v, v), 16), hi = _mm_srai_epi32 (_mm_unpackhi_epi16 (v, v), 16);
+            _mm_storeu_ps (dest + k,     _mm_mul_ps (_mm_cvtepi32_ps (lo), scale));
+            _mm_storeu_ps (dest + k + 4, _mm_mul_ps (_mm_cvtepi32_ps (hi), scale));
+        }
+        int16ToFloatScalar (dest + k, src + k, num - k);
+    }
+   #endif
+
+   #if JUCE_USE_ARM_NEON && defined(__aarch64__)
+    inline void int16ToFloatNEON (float* dest, const int16_t* src, int num) {
+        int k = 0;
+        for (; k + 8 <= num; k += 8) {
+            const int16x8_t v = vld1q_s16 (src + k);
+            vst1q_f32 (dest + k,     vmulq_n_f32 (vcvtq_f32_s32 (vmovl_s16 (vget_low_s16 (v))),  1.0f / 32768.0f));
+            vst1q_f32 (dest + k + 4, vmulq_n_f32 (vcvtq_f32_s32 (vmovl_s16 (vget_high_s16 (v))), 1.0f / 32768.0f));
+        }
+        int16ToFloatScalar (dest + k, src + k, num - k);
+    }
+   #endif
+
+    // Runtime dispatch, resolved once.
+    inline Int16ToFloatFn getInt16ToFloat() {
+        static const Int16ToFloatFn fn = [] () -> Int16ToFloatFn {
+           #if JUCE_USE_SSE_INTRINSICS
+            if (juce::SystemStats::hasSSE2()) return int16ToFloatSSE;
+           #endif
+           #if JUCE_USE_ARM_NEON && defined(__aarch64__)
+            return int16ToFloatNEON;
+           #endif
+            return int16ToFloatScalar;
+        }();
+        return fn;
+    }
+
+    // Branch-free so the compiler can vectorise it.
+    inline void int24ToFloat (float* dest, const uint8_t* src, int num) {
+        for (int k = 0; k < num; ++k, src += 3) {
+            const auto v = (int32_t) ((uint32_t) src[0] << 8 | (uint32_t) src[1] << 16 | (uint32_t) src[2] << 24) >> 8;
+            dest[k] = (float) v * (1.0f / 8388608.0f);
+        }
+    }
+
+    // Offline. Rounds and clips; integer sources of the same width round-trip exactly.
+    inline void floatToInt16 (int16_t* dest, const float* src, int num) {
+        for (int k = 0; k < num; ++k) dest[k] = (int16_t) juce::jlimit (-32768.0f, 32767.0f, std::round (src[k] * 32768.0f));
+    }
+    inline void floatToInt24 (uint8_t* dest, const float* src, int num) {
+        for (int k = 0; k < num; ++k, dest += 3) {
+            const auto v = (int32_t) juce::jlimit (-8388608.0f, 8388607.0f, std::round (src[k] * 8388608.0f));
+            dest[0] = (uint8_t) v; dest[1] = (uint8_t) (v >> 8); dest[2] = (uint8_t) (v >> 16);
+        }
+    }
+}
+
+// Multichannel audio held as float, 16-bit or packed 24-bit PCM. Integer formats halve
+// (or cut by a quarter) the memory of a float buffer and the bytes a voice pulls through
+// the cache; read() converts to float in blocks. Float buffers can also be read in place.
+class PcmBuffer {
+public:
+    // Not on the audio thread. Contents start silent.
+    void setSize (pcm::Format newFormat, int channels, int samples) {
+        format = newFormat; numChannels = juce::jmax (0, channels); numSamples = juce::jmax (0, samples);
+        stride = (size_t) numSamples * (size_t) pcm::bytesPerSample (format);
+        data.free(); if (stride > 0 && numChannels > 0) data.calloc (stride * (size_t) numChannels);
+        toFloat16 = pcm::getInt16ToFloat();
+    }
+    pcm::Format getFormat() const { return format; }
+    bool isFloat() const { return format == pcm::Format::float32; }
+    int getNumChannels() const { return numChannels; }
+    int getNumSamples() const { return numSamples; }
+    size_t getSizeInBytes() const { return stride * (size_t) numChannels; }
+    // Float buffers only: the samples themselves.
+    const float* getFloatPointer (int channel, juce::int64 start) const {
+        jassert (isFloat());
+        return reinterpret_cast<const float*> (bytes (channel, start));
+    }
+    // Realtime-safe. [start, start+num) of channel as float; the caller keeps it in range.
+    void read (int channel, juce::int64 start, float* dest, int num) const {
+        if (num <= 0) return;
+        const char* src = bytes (channel, start);
+        switch (format) {
+            case pcm::Format::int16: toFloat16 (dest, reinterpret_cast<const int16_t*> (src), num); break;
+            case pcm::Format::int24: pcm::int24ToFloat (dest, reinterpret_cast<const uint8_t*> (src), num); break;
+            default:                 std::memcpy (dest, src, (size_t) num * sizeof (float)); break;
+        }
+    }
+    void write (int channel, juce::int64 start, const float* src, int num) {
+        if (num <= 0) return;
+        char* dest = const_cast<char*> (bytes (channel, start));
+        switch (format) {
+            case pcm::Format::int16: pcm::floatToInt16 (reinterpret_cast<int16_t*> (dest), src, num); break;
+            case pcm::Format::int24: pcm::floatToInt24 (reinterpret_cast<uint8_t*> (dest), src, num); break;
+            default:                 std::memcpy (dest, src, (size_t) num * sizeof (float)); break;
+        }
+    }
+private:
+    const char* bytes (int channel, juce::int64 start) const {
+        jassert (channel >= 0 && channel < numChannels && start >= 0 && start <= numSamples);
+        return data.get() + stride * (size_t) channel + (size_t) start * (size_t) pcm::bytesPerSample (format);
+    }
+    juce::HeapBlock<char> data; size_t stride { 0 };
+    pcm::Format format { pcm::Format::float32 }; int numChannels { 0 }, numSamples { 0 };
+    pcm::Int16ToFloatFn toFloat16 { pcm::int16ToFloatScalar };
+};
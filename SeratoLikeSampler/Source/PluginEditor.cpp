@@ -94,7 +94,7 @@ NoobToolsAudioProcessorEditor::NoobToolsAudioProcessorEditor (NoobToolsAudioProc
             auto file = fc.getResult();
             juce::FileOutputStream os (file);
             if (os.openedOk()) {
-                const auto& slices = engine.getSlices();
+                const auto slices = engine.getSlices();
                 const double sr = engine.getPool().getSampleRate();
                 os << "index,start_samples,end_samples,duration_samples,start_sec,end_sec,duration_sec,midi_note,note_name\n";
                 for (size_t i = 0; i < slices.size(); ++i) {
@@ -115,44 +115,14 @@ NoobToolsAudioProcessorEditor::NoobToolsAudioProcessorEditor (NoobToolsAudioProc
     };
     addAndMakeVisible (btnExportWavs);
     addAndMakeVisible (btnNormalize);
+    // Exports in the background; while it runs the button shows progress and cancels
     btnExportWavs.onClick = [this]{
         auto& engine = processor.getEngine();
-        const auto& src = engine.getPool().getBuffer();
-        if (src.getNumSamples() <= 0) return;
+        if (engine.isExporting()) { engine.cancelExport(); return; }
+        if (engine.getPool().getLengthInSamples() <= 0) return;
         juce::FileChooser fc ("Choose export folder", juce::File::getSpecialLocation (juce::File::userDesktopDirectory), "");
         if (! fc.browseForDirectory()) return;
-        auto dir = fc.getResult();
-        const auto& slices = engine.getSlices();
-        juce::WavAudioFormat fmt;
-        for (size_t i = 0; i < slices.size(); ++i) {
-            const auto& s = slices[i];
-            int n = juce::jmax (0, s.endSample - s.startSample);
-            if (n <= 0) continue;
-            juce::AudioBuffer<float> tmp (src.getNumChannels(), n);
-            for (int ch = 0; ch < tmp.getNumChannels(); ++ch)
-                tmp.copyFrom (ch, 0, src, juce::jmin (ch, src.getNumChannels()-1), s.startSample, n);
-            if (btnNormalize.getToggleState()) {
-                float peak = 0.0f;
-                for (int ch = 0; ch < tmp.getNumChannels(); ++ch)
-                    peak = juce::jmax (peak, tmp.getMagnitude (ch, 0, n));
-                if (peak > 0.00001f) {
-                    float g = 0.999f / peak;
-                    for (int ch = 0; ch < tmp.getNumChannels(); ++ch)
-                        tmp.applyGain (ch, 0, n, g);
-                }
-            }
-            static const char* names[12] = {"C","C#","D","D#","E","F","F#","G","G#","A","A#","B"};
-            int octave = (s.midiNote / 12) - 1; const char* nm = names[s.midiNote % 12];
-            auto base = juce::String::formatted ("%03d_%s%d_%d_%d.wav", (int) i, nm, octave, s.startSample, s.endSample);
-            auto outFile = dir.getChildFile (base);
-            std::unique_ptr<juce::FileOutputStream> os (outFile.createOutputStream());
-            if (os && os->openedOk()) {
-                if (auto* rawWriter = fmt.createWriterFor (os.release(), (double) engine.getPool().getSampleRate(), (unsigned int) tmp.getNumChannels(), 24, {}, 0)) {
-                    std::unique_ptr<juce::AudioFormatWriter> writer (rawWriter);
-                    writer->writeFromAudioSampleBuffer (tmp, 0, n);
-                }
-            }
-        }
+        engine.exportSlices (fc.getResult(), btnNormalize.getToggleState());
     };
     const juce::String keyMap = "1234567890qwerty"; // keyboard mapping for pads
     // Palette approximating the reference image (orange -> green -> purple/blue)
@@ -188,9 +158,7 @@ NoobToolsAudioProcessorEditor::NoobToolsAudioProcessorEditor (NoobToolsAudioProc
                 processor.getEngine().createUserSliceAtCurrent (midiNote, btnQuantize.getToggleState());
                 repaint();
             } else {
-                juce::MidiMessage m = juce::MidiMessage::noteOn (1, midiNote, (juce::uint8) 100); juce::MidiBuffer buf; buf.addEvent (m, 0);
-                auto* proc = dynamic_cast<NoobToolsAudioProcessor*>(getAudioProcessor());
-                if (proc != nullptr) { juce::AudioBuffer<float> scratch; scratch.setSize (2, 128, false, false, true); proc->processBlock (scratch, buf); }
+                processor.getEngine().postNoteOn (midiNote);
             }
         };
     }
@@ -217,6 +185,11 @@ NoobToolsAudioProcessorEditor::NoobToolsAudioProcessorEditor (NoobToolsAudioProc
 
     startTimerHz (30);
 }
+void NoobToolsAudioProcessorEditor::updateExportButton() {
+    auto& engine = processor.getEngine();
+    const auto text = engine.isExporting() ? "Cancel " + juce::String (juce::roundToInt (engine.getExportProgress() * 100.0f)) + "%" : juce::String ("Export WAVs");
+    if (btnExportWavs.getButtonText() != text) btnExportWavs.setButtonText (text);
+}
 void NoobToolsAudioProcessorEditor::paint (juce::Graphics& g) {
     g.fillAll (juce::Colours::black.withBrightness (0.11f));
     auto r = getLocalBounds();
@@ -279,7 +252,12 @@ void NoobToolsAudioProcessorEditor::paint (juce::Graphics& g) {
 }
 void NoobToolsAudioProcessorEditor::resized() {}
 void NoobToolsAudioProcessorEditor::drawWaveform (juce::Graphics& g, juce::Rectangle<int> r) {
-    auto& engine = processor.getEngine(); const auto& wf = engine.getWaveform().get();
+    auto& engine = processor.getEngine(); const auto& pool = engine.getPool();
+    // One column per pixel from the pyramid level nearest the zoom: O(width) at any zoom
+    const auto [visStart, visWidth] = getVisibleRange();
+    const double viewStart = (double) visStart * (double) pool.getFullLengthInSamples();
+    const double spp = (double) visWidth * (double) pool.getFullLengthInSamples() / (double) juce::jmax (1, r.getWidth());
+    const auto wf = engine.getWaveform().get (engine.getWaveform().levelFor (spp));
     // Background
     g.setColour (juce::Colour::fromRGB (58, 60, 62));
     g.fillRoundedRectangle (r.toFloat(), 4.0f);
@@ -291,7 +269,8 @@ void NoobToolsAudioProcessorEditor::drawWaveform (juce::Graphics& g, juce::Recta
         int gx = r.getX() + (r.getWidth() * i) / 10;
         g.drawVerticalLine (gx, (float) r.getY(), (float) r.getBottom());
     }
-    if (engine.isLoading()) { g.setColour (juce::Colours::white.withAlpha (0.7f)); g.drawFittedText ("Loading...", r, juce::Justification::centred, 1); return; }
+    // Bins fill in left to right while a file decodes; only the first chunk is waited for
+    if (engine.isLoading() && wf.numReady() == 0) { g.setColour (juce::Colours::white.withAlpha (0.7f)); g.drawFittedText ("Loading...", r, juce::Justification::centred, 1); return; }
     if (wf.empty()) {
         // Show large logo in the drop area; disappears once audio is loaded
         if (appLogoDrawable || appLogo.isValid()) {
@@ -326,26 +305,15 @@ void NoobToolsAudioProcessorEditor::drawWaveform (juce::Graphics& g, juce::Recta
         }
         return;
     }
-    const int N = (int) wf.size();
-    int startBin = 0, endBin = N;
-    if (zoom > 1.0f) {
-        int visible = juce::jmax (1, (int) std::round ((float) N / zoom));
-        startBin = juce::jlimit (0, juce::jmax (0, N - 1), (int) std::round (offset * (N - visible)));
-        endBin = juce::jlimit (startBin + 1, N, startBin + visible);
-    }
-    int binsShown = juce::jmax (1, endBin - startBin);
     // Time ruler ticks (seconds) across current view
     {
-        const auto& pool = engine.getPool();
         double sr = juce::jmax (1.0, pool.getSampleRate());
-        int totalSamples = pool.getBuffer().getNumSamples();
+        const juce::int64 totalSamples = pool.getFullLengthInSamples();
         if (totalSamples > 0) {
             double totalSec = (double) totalSamples / sr;
             // Visible window start/end in seconds
-            double visStartNorm = (double) startBin / (double) N;
-            double visWidthNorm = (double) binsShown / (double) N;
-            double aSec = visStartNorm * totalSec;
-            double bSec = (visStartNorm + visWidthNorm) * totalSec;
+            double aSec = (double) visStart * totalSec;
+            double bSec = (double) (visStart + visWidth) * totalSec;
             // Choose tick spacing: 0.1,0.2,0.5,1,2,5,10...
             double targetPx = 80.0; // desired spacing in pixels
             double secPerPx = (bSec - aSec) / (double) r.getWidth();
@@ -374,22 +342,45 @@ void NoobToolsAudioProcessorEditor::drawWaveform (juce::Graphics& g, juce::Recta
     }
     // draw waveform min/max bars in visible range
     g.setColour (juce::Colours::white.withAlpha (0.95f));
-    for (int bi = startBin; bi < endBin; ++bi) {
-        float t = (float) (bi - startBin) / (float) binsShown;
-        int x = r.getX() + (int) std::round (t * (float) r.getWidth());
-        float mn = wf[(size_t) bi].first; float mx = wf[(size_t) bi].second;
-        int y1 = r.getCentreY() - (int) (mx * (r.getHeight() * 0.45f));
-        int y2 = r.getCentreY() + (int) (mn * (r.getHeight() * 0.45f));
-        g.drawVerticalLine (x, (float) y1, (float) y2);
+    auto drawColumn = [&g, &r] (int px, WaveformCache::Bin bin) {
+        int y1 = r.getCentreY() - (int) (bin.second * (r.getHeight() * 0.45f));
+        int y2 = r.getCentreY() + (int) (bin.first * (r.getHeight() * 0.45f));
+        g.drawVerticalLine (r.getX() + px, (float) y1, (float) y2);
+    };
+    if (spp < (double) wf.binSize) {
+        // Zoomed past the finest level: measure the visible samples directly
+        const auto first = (juce::int64) viewStart;
+        const int num = (int) juce::jlimit<juce::int64> (0, (juce::int64) std::ceil (spp * r.getWidth()) + 1, pool.getLengthInSamples() - first);
+        if (num > 0) {
+            detailScratch.setSize (juce::jmax (1, pool.getNumChannels()), num, false, false, true);
+            pool.read (detailScratch, 0, first, num);
+            for (int px = 0; px < r.getWidth(); ++px) {
+                const int s0 = (int) (px * spp), s1 = juce::jmin (num, juce::jmax (s0 + 1, (int) ((px + 1) * spp)));
+                if (s0 >= num) break;
+                drawColumn (px, WaveformCache::measure (detailScratch, s0, s1 - s0));
+            }
+        }
+    } else {
+        for (int px = 0; px < r.getWidth(); ++px) {
+            const int b0 = (int) ((viewStart + px * spp) / wf.binSize);
+            const int b1 = juce::jmin (wf.numReady(), juce::jmax (b0 + 1, (int) ((viewStart + (px + 1) * spp) / wf.binSize)));
+            if (b0 >= b1) break;
+            WaveformCache::Bin bin { 1e9f, -1e9f };
+            for (int bi = b0; bi < b1; ++bi) { bin.first = juce::jmin (bin.first, wf[(size_t) bi].first); bin.second = juce::jmax (bin.second, wf[(size_t) bi].second); }
+            drawColumn (px, bin);
+        }
+    }
+    if (engine.isLoading()) {
+        g.setColour (juce::Colours::white.withAlpha (0.6f));
+        g.setFont (juce::Font (12.0f));
+        g.drawFittedText ("Loading " + juce::String (100 * wf.numReady() / juce::jmax (1, (int) wf.size())) + "%", r.reduced (6, 4).removeFromBottom (14), juce::Justification::right, 1);
     }
-    const auto& slices = engine.getSlices(); g.setColour (juce::Colours::orange.withAlpha (0.8f));
-    const auto& poolBuf = engine.getPool().getBuffer(); int totalSamples = poolBuf.getNumSamples();
+    const auto slices = engine.getSlices(); g.setColour (juce::Colours::orange.withAlpha (0.8f));
+    const int totalSamples = engine.getTotalLengthSamples();
     if (totalSamples > 0) {
         for (const auto& s : slices) {
             float global = s.startSample / (float) totalSamples;
             // map to visible 0..1
-            float visStart = (float) startBin / (float) N;
-            float visWidth = (float) binsShown / (float) N;
             float local = visWidth > 0.0f ? (global - visStart) / visWidth : global;
             if (local >= 0.0f && local <= 1.0f) {
                 int x = r.getX() + (int) std::round (local * (float) r.getWidth());
@@ -402,7 +393,7 @@ void NoobToolsAudioProcessorEditor::drawWaveform (juce::Graphics& g, juce::Recta
     const int handleTop = r.getY() + 8;
     for (int i = 1; i < (int) slices.size(); ++i) {
         float global = (totalSamples > 0) ? (slices[(size_t) i].startSample / (float) totalSamples) : 0.0f;
-        float local = ((float) binsShown / (float) N) > 0.0f ? (global - ((float) startBin / (float) N)) / ((float) binsShown / (float) N) : global;
+        float local = visWidth > 0.0f ? (global - visStart) / visWidth : global;
         if (local < 0.0f || local > 1.0f) continue;
         int cx = r.getX() + (int) std::round (local * (float) r.getWidth());
         juce::Rectangle<int> hRect (cx - handleW/2, handleTop, handleW, handleH);
@@ -419,8 +410,6 @@ void NoobToolsAudioProcessorEditor::drawWaveform (juce::Graphics& g, juce::Recta
     }
     // Draw loop region
     auto loopNorm = engine.getLoopRegionNorm();
-    float visStart = (float) startBin / (float) N;
-    float visWidth = (float) binsShown / (float) N;
     float aVis = visWidth > 0.0f ? (loopNorm.first - visStart) / visWidth : loopNorm.first;
     float bVis = visWidth > 0.0f ? (loopNorm.second - visStart) / visWidth : loopNorm.second;
     int lx1 = r.getX() + (int) std::round (juce::jlimit (0.0f, 1.0f, aVis) * r.getWidth());
@@ -471,14 +460,8 @@ bool NoobToolsAudioProcessorEditor::keyPressed (const juce::KeyPress& key) {
         juce::juce_wchar ch = key.getTextCharacter();
         int idx = map.indexOfChar (ch);
         if (idx >= 0) {
-            auto* proc = dynamic_cast<NoobToolsAudioProcessor*>(getAudioProcessor());
-            if (proc != nullptr) {
-                int base = (int) proc->getAPVTS().getRawParameterValue("basenote")->load();
-                juce::MidiMessage m = juce::MidiMessage::noteOn (1, base + idx, (juce::uint8) 100);
-                juce::MidiBuffer buf; buf.addEvent (m, 0);
-                juce::AudioBuffer<float> scratch; scratch.setSize (2, 128, false, false, true);
-                proc->processBlock (scratch, buf);
-            }
+            int base = (int) processor.getAPVTS().getRawParameterValue("basenote")->load();
+            processor.getEngine().postNoteOn (base + idx);
             return true;
         }
     }
@@ -491,9 +474,7 @@ bool NoobToolsAudioProcessorEditor::keyPressed (const juce::KeyPress& key) {
         if (editMode) {
             processor.getEngine().createUserSliceAtCurrent (midiNote, btnQuantize.getToggleState());
         } else {
-            juce::MidiMessage m = juce::MidiMessage::noteOn (1, midiNote, (juce::uint8) 100); juce::MidiBuffer buf; buf.addEvent (m, 0);
-            auto* proc = dynamic_cast<NoobToolsAudioProcessor*>(getAudioProcessor());
-            if (proc != nullptr) { juce::AudioBuffer<float> scratch; scratch.setSize (2, 128, false, false, true); proc->processBlock (scratch, buf); }
+            processor.getEngine().postNoteOn (midiNote);
         }
         return true;
     }
@@ -526,16 +507,8 @@ void NoobToolsAudioProcessorEditor::mouseDrag (const juce::MouseEvent& e) {
     }
     if (draggingBoundaryIndex >= 1 && lastWaveRect.contains (e.getPosition())) {
         auto& engine = processor.getEngine();
-        const auto& wf = engine.getWaveform().get();
-        const int N = (int) wf.size();
-        const int totalSamples = engine.getPool().getBuffer().getNumSamples();
-        float visStart = 0.0f, visWidth = 1.0f;
-        if (zoom > 1.0f && N > 0) {
-            int visible = juce::jmax (1, (int) std::round ((float) N / zoom));
-            int startBin = juce::jlimit (0, juce::jmax (0, N - 1), (int) std::round (offset * (N - visible)));
-            visStart = (float) startBin / (float) N;
-            visWidth = (float) visible / (float) N;
-        }
+        const int totalSamples = engine.getTotalLengthSamples();
+        const auto [visStart, visWidth] = getVisibleRange();
         float local = juce::jlimit (0.0f, 1.0f, (e.x - lastWaveRect.getX()) / (float) lastWaveRect.getWidth());
         float global = juce::jlimit (0.0f, 1.0f, visStart + local * visWidth);
         int sample = (int) std::round (global * (float) juce::jmax (0, totalSamples));
@@ -554,7 +527,7 @@ void NoobToolsAudioProcessorEditor::mouseUp (const juce::MouseEvent& e) {
             float b = juce::jmax (dragStartNorm, dragEndNorm);
             if (btnSnap.getToggleState()) {
                 // Snap to nearest slice boundaries
-                const auto& slices = processor.getEngine().getSlices();
+                const auto slices = processor.getEngine().getSlices();
                 const int total = processor.getEngine().getTotalLengthSamples();
                 auto snapToNearest = [&slices](int samp){
                     if (slices.empty()) return 0;
@@ -603,17 +576,9 @@ void NoobToolsAudioProcessorEditor::mouseMove (const juce::MouseEvent& e) {
     hoverBoundaryIndex = -1;
     if (! lastWaveRect.contains (e.getPosition())) { setMouseCursor (juce::MouseCursor::NormalCursor); return; }
     auto& engine = processor.getEngine();
-    const auto& wf = engine.getWaveform().get();
-    const int N = (int) wf.size();
-    const int totalSamples = engine.getPool().getBuffer().getNumSamples();
-    float visStart = 0.0f, visWidth = 1.0f;
-    if (zoom > 1.0f && N > 0) {
-        int visible = juce::jmax (1, (int) std::round ((float) N / zoom));
-        int startBin = juce::jlimit (0, juce::jmax (0, N - 1), (int) std::round (offset * (N - visible)));
-        visStart = (float) startBin / (float) N;
-        visWidth = (float) visible / (float) N;
-    }
-    const auto& slices = engine.getSlices();
+    const int totalSamples = engine.getTotalLengthSamples();
+    const auto [visStart, visWidth] = getVisibleRange();
+    const auto slices = engine.getSlices();
     int bestIdx = -1; int bestDist = 9999;
     const int thresholdPx = 8;
     const int handleW = 8, handleH = 12; const int handleTop = lastWaveRect.getY() + 2;
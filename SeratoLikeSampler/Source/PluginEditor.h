@@ -12,7 +12,7 @@ public:
     ~NoobToolsAudioProcessorEditor() override;
     void paint (juce::Graphics&) override;
     void resized() override;
-    void timerCallback() override { repaint(); }
+    void timerCallback() override { updateExportButton(); repaint(); }
     bool keyPressed (const juce::KeyPress& key) override;
     void mouseDown (const juce::MouseEvent& e) override;
     void mouseDrag (const juce::MouseEvent& e) override;
@@ -24,6 +24,11 @@ public:
     void filesDropped (const juce::StringArray& files, int x, int y) override;
 private:
     void drawWaveform (juce::Graphics& g, juce::Rectangle<int> r);
+    // Visible part of the file as { start, width }, normalised to the full length
+    std::pair<float,float> getVisibleRange() const {
+        const float width = 1.0f / juce::jmax (1.0f, zoom);
+        return { offset * (1.0f - width), width };
+    }
     NoobToolsAudioProcessor& processor;
     SamplerLookAndFeel lookAndFeel;
     juce::Slider attack, release, cutoff, reso, gain, baseNote, maxSlices, sensitivity, minGapMs;
@@ -32,6 +37,7 @@ private:
     juce::TextButton btnZoomIn { "+" };
     juce::TextButton btnZoomOut { "-" };
     // Branding
+    void updateExportButton();
     juce::Image appLogo; // raster fallback
     std::unique_ptr<juce::Drawable> appLogoDrawable; // preferred (SVG)
     juce::TextButton btnPreview { "Preview" };
@@ -59,5 +65,6 @@ private:
     int hoverBoundaryIndex { -1 }; // slice index of the boundary being hovered (== start of slice i), i>=1
     int draggingBoundaryIndex { -1 };
     int lastMouseX { -1 };
+    juce::AudioBuffer<float> detailScratch; // raw samples for views zoomed past the finest waveform level
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (NoobToolsAudioProcessorEditor)
 };
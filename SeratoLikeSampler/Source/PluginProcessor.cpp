@@ -2,32 +2,66 @@
 #include "PluginEditor.h"
 NoobToolsAudioProcessor::NoobToolsAudioProcessor()
     : juce::AudioProcessor (BusesProperties().withOutput ("Output", juce::AudioChannelSet::stereo(), true))
-    , apvts (*this, nullptr, "PARAMS", params::createLayout()) {}
+    , apvts (*this, nullptr, "PARAMS", params::createLayout()) {
+    pAttack      = apvts.getRawParameterValue ("attack");
+    pRelease     = apvts.getRawParameterValue ("release");
+    pCutoff      = apvts.getRawParameterValue ("cutoff");
+    pReso        = apvts.getRawParameterValue ("reso");
+    pGain        = apvts.getRawParameterValue ("gain");
+    pBaseNote    = apvts.getRawParameterValue ("basenote");
+    pMaxSlices   = apvts.getRawParameterValue ("maxslices");
+    pSensitivity = apvts.getRawParameterValue ("sensitivity");
+    pThreshMode  = apvts.getRawParameterValue ("threshmode");
+    pMinGapMs    = apvts.getRawParameterValue ("mingapms");
+    pChoke       = apvts.getRawParameterValue ("choke");
+    pGate        = apvts.getRawParameterValue ("gate");
+    pSteal       = apvts.getRawParameterValue ("steal");
+    pVoices      = apvts.getRawParameterValue ("voices");
+    pInterp      = apvts.getRawParameterValue ("interp");
+    pEngine      = apvts.getRawParameterValue ("tpengine");
+    pMasterKey   = apvts.getRawParameterValue ("masterkey");
+    pMasterTempo = apvts.getRawParameterValue ("mastertempo");
+    pKeyMode     = apvts.getRawParameterValue ("keymode");
+    pStorage     = apvts.getRawParameterValue ("storage");
+    startTimerHz (10);
+}
 bool NoobToolsAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts) const {
     return layouts.getMainOutputChannelSet() == juce::AudioChannelSet::stereo();
 }
 void NoobToolsAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlock) {
-    engine.prepare (sampleRate, samplesPerBlock);
+    engine.prepare (sampleRate, samplesPerBlock, (int) pVoices->load());
+    setLatencySamples (engine.getLatencySamples());
+}
+void NoobToolsAudioProcessor::timerCallback() {
+    engine.buildMasterBus();
+    if (const int latency = engine.getLatencySamples(); latency != getLatencySamples()) setLatencySamples (latency);
 }
 void NoobToolsAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midi) {
-    auto attack  = apvts.getRawParameterValue("attack")->load();
-    auto release = apvts.getRawParameterValue("release")->load();
-    auto cutoff  = apvts.getRawParameterValue("cutoff")->load();
-    auto reso    = apvts.getRawParameterValue("reso")->load();
-    auto gain    = apvts.getRawParameterValue("gain")->load();
-    auto baseNote   = (int) apvts.getRawParameterValue("basenote")->load();
-    auto maxSlices  = (int) apvts.getRawParameterValue("maxslices")->load();
-    auto sensitivity=       apvts.getRawParameterValue("sensitivity")->load();
-    auto minGapMs   =       apvts.getRawParameterValue("mingapms")->load();
+    const rt::ScopedAudioThread audioThread;
+    auto attack  = pAttack->load();
+    auto release = pRelease->load();
+    auto cutoff  = pCutoff->load();
+    auto reso    = pReso->load();
+    auto gain    = pGain->load();
+    auto baseNote   = (int) pBaseNote->load();
+    auto maxSlices  = (int) pMaxSlices->load();
+    auto sensitivity=       pSensitivity->load();
+    auto medianTh   = (int) pThreshMode->load() == 1;
+    auto minGapMs   =       pMinGapMs->load();
     engine.setParams (attack, release, cutoff, reso, gain);
-    engine.setSliceControls (baseNote, maxSlices, sensitivity);
+    engine.setSliceControls (baseNote, maxSlices, sensitivity, medianTh);
     engine.setMinGapMs (minGapMs);
     // Playback behaviour
     {
-        auto choke = (bool) apvts.getRawParameterValue("choke")->load();
+        auto choke = pChoke->load() > 0.5f;
         engine.setChoke (choke);
-        auto gate  = (bool) apvts.getRawParameterValue("gate")->load();
+        auto gate  = pGate->load() > 0.5f;
         engine.setGate (gate);
+        engine.setStealPolicy ((VoiceStealPolicy) juce::jlimit (0, 2, (int) pSteal->load()));
+        engine.setResampleQuality ((BlockResampler::Quality) juce::jlimit (0, 2, (int) pInterp->load()));
+        engine.setTimePitchBackend ((TimePitchEngine::Backend) juce::jlimit (0, 2, (int) pEngine->load()));
+        engine.setMasterKeyTempo ((float) (int) pMasterKey->load(), pMasterTempo->load(), (int) pKeyMode->load() == 1);
+        engine.setSampleStorage ((SamplePool::Storage) juce::jlimit (0, 2, (int) pStorage->load()));
     }
     engine.render (buffer, midi);
 }
@@ -4,10 +4,11 @@
 #include "AudioEngine.h"
 #include "Params.h"
 class NoobToolsAudioProcessor : public juce::AudioProcessor,
-                                   public juce::FileDragAndDropTarget {
+                                   public juce::FileDragAndDropTarget,
+                                   private juce::Timer {
 public:
     NoobToolsAudioProcessor();
-    ~NoobToolsAudioProcessor() override = default;
+    ~NoobToolsAudioProcessor() override { stopTimer(); }
     void prepareToPlay (double sampleRate, int samplesPerBlock) override;
     void releaseResources() override {}
     bool isBusesLayoutSupported (const BusesLayout& layouts) const override;
@@ -30,6 +31,16 @@ public:
     juce::AudioProcessorValueTreeState& getAPVTS() { return apvts; }
     AudioEngine& getEngine() { return engine; }
 private:
+    // Builds the master bus stage once it is asked for, and reports the engine latency to
+    // the host when the backend or key mode changes it
+    void timerCallback() override;
     juce::AudioProcessorValueTreeState apvts;
+    // Raw parameter pointers resolved once; looking them up by name allocates
+    std::atomic<float>* pAttack {}; std::atomic<float>* pRelease {}; std::atomic<float>* pCutoff {};
+    std::atomic<float>* pReso {}; std::atomic<float>* pGain {}; std::atomic<float>* pBaseNote {};
+    std::atomic<float>* pMaxSlices {}; std::atomic<float>* pSensitivity {}; std::atomic<float>* pThreshMode {}; std::atomic<float>* pMinGapMs {};
+    std::atomic<float>* pChoke {}; std::atomic<float>* pGate {}; std::atomic<float>* pSteal {}; std::atomic<float>* pVoices {}; std::atomic<float>* pInterp {};
+    std::atomic<float>* pEngine {}; std::atomic<float>* pMasterKey {}; std::atomic<float>* pMasterTempo {}; std::atomic<float>* pKeyMode {};
+    std::atomic<float>* pStorage {};
     AudioEngine engine;
 };
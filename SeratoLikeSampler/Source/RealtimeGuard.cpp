@@ -0,0 +1,37 @@
+#include "RealtimeGuard.h"
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+[[noreturn]] void rt::reportViolation (const char* what) {
+    audioThreadFlag() = false; // don't recurse if stderr allocates
+    std::fputs ("Noob_Tools realtime violation: ", stderr);
+    std::fputs (what, stderr);
+    std::fputs ("\n", stderr);
+    std::fflush (stderr);
+    std::abort();
+}
+
+#if defined(NOOB_RT_CHECKS)
+// Global allocation hooks. Over-aligned new/delete are left to the runtime.
+namespace {
+    void* checkedAlloc (std::size_t n) {
+        if (rt::isAudioThread()) rt::reportViolation ("heap allocation on the audio thread");
+        return std::malloc (n == 0 ? 1 : n);
+    }
+    void checkedFree (void* p) noexcept {
+        if (p != nullptr && rt::isAudioThread()) rt::reportViolation ("heap deallocation on the audio thread");
+        std::free (p);
+    }
+}
+void* operator new (std::size_t n)   { if (void* p = checkedAlloc (n)) return p; throw std::bad_alloc(); }
+void* operator new[] (std::size_t n) { if (void* p = checkedAlloc (n)) return p; throw std::bad_alloc(); }
+void* operator new (std::size_t n, const std::nothrow_t&) noexcept   { return checkedAlloc (n); }
+void* operator new[] (std::size_t n, const std::nothrow_t&) noexcept { return checkedAlloc (n); }
+void operator delete (void* p) noexcept   { checkedFree (p); }
+void operator delete[] (void* p) noexcept { checkedFree (p); }
+void operator delete (void* p, std::size_t) noexcept   { checkedFree (p); }
+void operator delete[] (void* p, std::size_t) noexcept { checkedFree (p); }
+void operator delete (void* p, const std::nothrow_t&) noexcept   { checkedFree (p); }
+void operator delete[] (void* p, const std::nothrow_t&) noexcept { checkedFree (p); }
+#endif
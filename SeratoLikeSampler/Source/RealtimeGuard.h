@@ -0,0 +1,43 @@
+
+#pragma once
+#include <juce_core/juce_core.h>
+
+// Realtime-safety checks for the audio thread.
+// processBlock marks its thread with rt::ScopedAudioThread. When the project is
+// configured with NOOB_RT_CHECKS=ON, global operator new/delete (RealtimeGuard.cpp)
+// and rt::ScopedWriterLock abort with a message if they run on a marked thread.
+// In normal builds everything here compiles down to a thread-local flag write.
+namespace rt {
+    inline bool& audioThreadFlag() { thread_local bool flag = false; return flag; }
+    inline bool isAudioThread() { return audioThreadFlag(); }
+
+    // Prints 'what' to stderr and aborts. Defined in RealtimeGuard.cpp.
+    [[noreturn]] void reportViolation (const char* what);
+
+    inline void assertNotRealtime (const char* what) {
+       #if defined(NOOB_RT_CHECKS)
+        if (audioThreadFlag()) reportViolation (what);
+       #else
+        juce::ignoreUnused (what);
+       #endif
+    }
+
+    struct ScopedAudioThread {
+        ScopedAudioThread() : previous (audioThreadFlag()) { audioThreadFlag() = true; }
+        ~ScopedAudioThread() { audioThreadFlag() = previous; }
+        const bool previous;
+    };
+    // Temporarily lifts the check for a known, documented exception on the audio thread.
+    struct ScopedAllowBlocking {
+        ScopedAllowBlocking() : previous (audioThreadFlag()) { audioThreadFlag() = false; }
+        ~ScopedAllowBlocking() { audioThreadFlag() = previous; }
+        const bool previous;
+    };
+
+    namespace detail { struct NotRealtime { explicit NotRealtime (const char* what) { assertNotRealtime (what); } }; }
+    // Blocking lock for writer-side state; checked before the lock is taken.
+    struct ScopedWriterLock : private detail::NotRealtime, private juce::ScopedLock {
+        explicit ScopedWriterLock (const juce::CriticalSection& cs)
+            : detail::NotRealtime ("blocking lock taken on the audio thread"), juce::ScopedLock (cs) {}
+    };
+}
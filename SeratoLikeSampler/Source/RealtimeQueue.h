@@ -0,0 +1,32 @@
+#pragma once
+#include <juce_core/juce_core.h>
+#include <array>
+
+// Bounded single-producer/single-consumer FIFO over juce::AbstractFifo.
+// push() and pop() are wait-free and never allocate, so either end may be the audio
+// thread. Exactly one thread pushes and exactly one thread pops.
+template <typename T, int capacity>
+class RealtimeQueue {
+public:
+    // Returns false (and drops the item) when the queue is full.
+    bool push (const T& item) {
+        int start1, size1, start2, size2;
+        fifo.prepareToWrite (1, start1, size1, start2, size2);
+        if (size1 + size2 == 0) return false;
+        items[(size_t) (size1 > 0 ? start1 : start2)] = item;
+        fifo.finishedWrite (1);
+        return true;
+    }
+    bool pop (T& item) {
+        int start1, size1, start2, size2;
+        fifo.prepareToRead (1, start1, size1, start2, size2);
+        if (size1 + size2 == 0) return false;
+        item = items[(size_t) (size1 > 0 ? start1 : start2)];
+        fifo.finishedRead (1);
+        return true;
+    }
+
+private:
+    juce::AbstractFifo fifo { capacity };
+    std::array<T, capacity> items {};
+};
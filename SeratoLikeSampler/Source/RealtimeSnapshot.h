@@ -0,0 +1,73 @@
+
+#pragma once
+#include <array>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <algorithm>
+
+// RCU-style publication of immutable snapshots for the audio thread.
+// Writers (message/loader threads, serialised by the caller's lock) build a new T
+// and publish() it with a single pointer swap. Readers pin the current snapshot
+// with a ScopedRead (hazard pointer) and never block. Replaced snapshots are parked
+// on a retire list and deleted by the writer side once no reader still pins them,
+// so the audio thread never frees memory.
+template <typename T>
+class RealtimeSnapshot {
+public:
+    static constexpr int maxReaders = 4;
+
+    RealtimeSnapshot() : current (new T()) { for (auto& h : hazards) h.store (nullptr); }
+    ~RealtimeSnapshot() { delete current.load(); for (auto* p : retired) delete p; }
+
+    class ScopedRead {
+    public:
+        explicit ScopedRead (const RealtimeSnapshot& s) {
+            const T* p = s.current.load();
+            for (auto& h : s.hazards) {
+                const T* expected = nullptr;
+                if (h.compare_exchange_strong (expected, p)) { slot = &h; break; }
+            }
+            if (slot == nullptr) return; // all reader slots busy; treat as no data this block
+            // A publish may have happened between the load and the hazard store: re-validate
+            for (;;) { const T* now = s.current.load(); if (now == p) break; p = now; slot->store (p); }
+            ptr = p;
+        }
+        ~ScopedRead() { if (slot != nullptr) slot->store (nullptr); }
+        ScopedRead (const ScopedRead&) = delete;
+        ScopedRead& operator= (const ScopedRead&) = delete;
+        const T* get() const { return ptr; }
+        const T* operator->() const { return ptr; }
+        explicit operator bool() const { return ptr != nullptr; }
+    private:
+        std::atomic<const T*>* slot { nullptr };
+        const T* ptr { nullptr };
+    };
+
+    // Writer side only (caller serialises writers).
+    void publish (std::unique_ptr<T> next) {
+        if (next == nullptr) return;
+        T* old = current.exchange (next.release());
+        if (old != nullptr) retired.push_back (old);
+        collectGarbage();
+    }
+    // Frees retired snapshots no reader still pins. Never call from the audio thread.
+    void collectGarbage() {
+        retired.erase (std::remove_if (retired.begin(), retired.end(), [this](T* p) {
+            if (isPinned (p)) return false;
+            delete p; return true;
+        }), retired.end());
+    }
+    // Writer-side view of the latest published snapshot.
+    const T& latest() const { return *current.load(); }
+    size_t numRetired() const { return retired.size(); }
+
+private:
+    bool isPinned (const T* p) const {
+        for (auto& h : hazards) if (h.load() == p) return true;
+        return false;
+    }
+    std::atomic<T*> current;
+    mutable std::array<std::atomic<const T*>, maxReaders> hazards;
+    std::vector<T*> retired;
+};
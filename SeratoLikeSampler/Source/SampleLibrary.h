@@ -0,0 +1,123 @@
+#pragma once
+#include <juce_core/juce_core.h>
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <vector>
+#include "SamplePool.h"
+
+// Decoded files kept across loads, so going back to a file (the next track of a set,
+// another source for a kit) skips the decode and the analysis: each entry keeps its
+// SamplePool (audio, waveform pyramid, novelty curve), the onsets last picked from it and
+// its slice edits. Entries are found by file (path, size and modification time, no read)
+// and by a hash of their content, which the loader works out once a new file is playing;
+// a copy of a file already here is then folded into the existing entry (retire()).
+// The budget counts each file's conversions cached for other host rates too; past it those
+// are dropped first, then entries are evicted least recently used first, but never the
+// current file, one a published slice table still holds (use_count) or one a voice is
+// playing; retired entries go as soon as nothing holds them.
+// Not for the audio thread. The engine adds and evicts under both of its writer locks,
+// so either one is enough to read.
+class SampleLibrary {
+public:
+    static constexpr size_t defaultBudgetBytes = (size_t) 1 << 30;
+    struct OnsetKey {
+        float sensitivity { 0.0f }; bool median { false }; int maxSlices { 0 }; juce::int64 length { -1 };
+        bool operator== (const OnsetKey& o) const { return sensitivity == o.sensitivity && median == o.median && maxSlices == o.maxSlices && length == o.length; }
+    };
+    struct Entry {
+        juce::String hash; std::shared_ptr<SamplePool> pool;           // hash empty until worked out
+        juce::StringArray files;                                       // fileId()s known to hold this content
+        OnsetKey onsetKey; std::vector<SlicePoint> onsets;             // last pick and its settings
+        std::vector<int> manualTaps; std::map<int, float> gainByStart; // restored when it is current again
+        juce::uint64 lastUsed { 0 };
+    };
+
+    explicit SampleLibrary (size_t budget = defaultBudgetBytes) : budgetBytes (budget) {}
+    static juce::String fileId (const juce::File& file) {
+        return file.getFullPathName() + "|" + juce::String (file.getSize()) + "|" + juce::String (file.getLastModificationTime().toMilliseconds());
+    }
+    // Content hash of a file (64-bit, see contentHash()). Reads the whole file the first
+    // time; later calls for the same path, size and modification time are a lookup.
+    juce::String hashOf (const juce::File& file) {
+        const auto id = fileId (file);
+        {
+            const juce::ScopedLock sl (hashLock);
+            if (auto it = hashes.find (id); it != hashes.end()) return it->second;
+        }
+        const auto hash = contentHash (file);
+        const juce::ScopedLock sl (hashLock);
+        return hashes[id] = hash;
+    }
+    Entry* find (const juce::String& hash) {
+        if (hash.isEmpty()) return nullptr;
+        for (auto& e : entries) if (e->hash == hash) return e.get();
+        return nullptr;
+    }
+    Entry* find (const juce::File& file) {
+        const auto id = fileId (file);
+        for (auto& e : entries) if (e->files.contains (id)) return e.get();
+        return nullptr;
+    }
+    Entry* find (const SamplePool* pool) {
+        for (auto& e : entries) if (e->pool.get() == pool) return e.get();
+        return nullptr;
+    }
+    Entry& add (const juce::String& hash, const juce::File& file, std::shared_ptr<SamplePool> pool) {
+        entries.push_back (std::make_unique<Entry>());
+        auto& e = *entries.back(); e.hash = hash; e.files.add (fileId (file)); e.pool = std::move (pool); touch (e);
+        return e;
+    }
+    // Takes the entry out of every lookup (a duplicate, or a partial decode superseded);
+    // evict() drops it once nothing holds it.
+    void retire (Entry& e) { e.hash = {}; e.files.clear(); e.lastUsed = 0; }
+    void touch (Entry& e) { e.lastUsed = ++clock; }
+    template <typename Fn> void forEach (Fn&& fn) { for (auto& e : entries) fn (*e); }
+    size_t getMemoryBytes() const {
+        size_t bytes = 0;
+        for (auto& e : entries) bytes += e->pool->getMemoryBytes();
+        return bytes;
+    }
+    // Drops least recently used entries until the library fits its budget (or nothing
+    // more can go). 'current' is never dropped.
+    void evict (const SamplePool* current) {
+        const auto inUse = [current] (const Entry& e) { return e.pool.get() == current || e.pool.use_count() > 1 || e.pool->hasVoices(); };
+        entries.erase (std::remove_if (entries.begin(), entries.end(), [&] (const auto& e) { return e->files.isEmpty() && ! inUse (*e); }), entries.end());
+        size_t bytes = getMemoryBytes();
+        // Conversions kept for other host rates go before any file: they are only a rebuild away
+        for (auto& e : entries) { if (bytes <= budgetBytes) return; bytes -= e->pool->dropCachedConversions(); }
+        while (bytes > budgetBytes) {
+            auto victim = entries.end();
+            for (auto it = entries.begin(); it != entries.end(); ++it) {
+                if (inUse (**it)) continue;
+                if (victim == entries.end() || (*it)->lastUsed < (*victim)->lastUsed) victim = it;
+            }
+            if (victim == entries.end()) return;
+            bytes -= (*victim)->pool->getMemoryBytes();
+            entries.erase (victim);
+        }
+    }
+private:
+    // xxHash64-style rounds over 8-byte words, streamed in 1 MB blocks: disk speed, and
+    // collisions are out of reach for a library of files. Empty if unreadable.
+    static juce::String contentHash (const juce::File& file) {
+        juce::FileInputStream in (file);
+        if (! in.openedOk()) return {};
+        static constexpr juce::uint64 p1 = 0x9e3779b185ebca87ull, p2 = 0xc2b2ae3d27d4eb4full;
+        const auto round = [] (juce::uint64 h, juce::uint64 w) { h ^= w * p2; h = (h << 31) | (h >> 33); return h * p1; };
+        constexpr int blockBytes = 1 << 20;
+        juce::HeapBlock<char> block (blockBytes);
+        juce::uint64 h = p1 ^ (juce::uint64) file.getSize();
+        for (int n; (n = in.read (block.get(), blockBytes)) > 0;) {
+            int k = 0;
+            for (juce::uint64 w; k + 8 <= n; k += 8) { std::memcpy (&w, block.get() + k, 8); h = round (h, w); }
+            for (; k < n; ++k) h = round (h, (juce::uint8) block[k]);
+        }
+        h ^= h >> 33; h *= p2; h ^= h >> 29; h *= p1; h ^= h >> 32;
+        return juce::String::toHexString ((juce::int64) h);
+    }
+    std::vector<std::unique_ptr<Entry>> entries; // stable addresses
+    size_t budgetBytes; juce::uint64 clock { 0 };
+    juce::CriticalSection hashLock; std::map<juce::String, juce::String> hashes; // path|size|mtime -> hash
+};
@@ -1,23 +1,433 @@
-
 #pragma once
 #include <juce_audio_formats/juce_audio_formats.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <limits>
+#include <map>
+#include "DSP/TimePitch/SampleRateConverter.h"
+#include "PcmBuffer.h"
 #include "WaveformCache.h"
+#include "Slicer.h"
+// Per-reader scratch for streamed reads. Sized by prepare() off the audio thread.
+struct SampleReadScratch {
+    static constexpr int windowSamples = 2048; // file samples per step when a streamed file is resampled
+    void prepare (int capacity) { buffer.setSize (2, juce::jmax (1, capacity)); window.setSize (2, windowSamples + SampleRateConverter::taps + 2); }
+    int capacity() const { return buffer.getNumSamples(); }
+    juce::AudioBuffer<float> buffer, window; std::array<const float*, 2> ptrs {};
+};
+// The loaded sample. Files are decoded into RAM unless they are WAV/AIFF with a
+// decoded size above streamingThresholdBytes; those are played straight from a
+// memory map, and a read-ahead thread pre-faults the pages just ahead of each play
+// head so only the regions being played need to be resident.
+// Loading is chunked: beginLoad() then decodeNextChunk() until it returns false. Each
+// chunk extends the readable length, so the start of a file plays while the rest decodes.
+// Two coordinate systems: the file's samples (slices, analysis, waveform, read()) and
+// playback samples at the host rate (getReadPointers and friends). They differ only for
+// RAM files at another rate than the host: those get a converted copy, built as the file
+// decodes and whenever the host rate changes (kept per rate, so switching back is
+// instant); toPlayback()/toSource() map positions exactly. Streamed files at another rate
+// are resampled as they are read, with the same converter over a window of the map, so
+// they stay out of RAM.
+// RAM audio is held as float or, per Storage, as 16/24-bit PCM (PcmBuffer); integer
+// storage is converted to float block by block as it is read, like streamed audio.
 class SamplePool {
 public:
-    bool loadFromFile (const juce::File& file) {
-        juce::AudioFormatManager fm; fm.registerBasicFormats();
-        std::unique_ptr<juce::AudioFormatReader> reader (fm.createReaderFor (file));
-        if (! reader) return false;
-        buffer.setSize ((int) reader->numChannels, (int) reader->lengthInSamples);
-        reader->read (&buffer, 0, (int) reader->lengthInSamples, 0, true, true);
-        sampleRate = reader->sampleRate; fileName = file.getFileNameWithoutExtension();
-        waveform.build (buffer, 1024); return true;
-    }
-    void clear() { buffer.setSize (0, 0); fileName.clear(); sampleRate = 44100.0; waveform = WaveformCache{}; }
-    const juce::AudioBuffer<float>& getBuffer() const { return buffer; }
+    // float32: always float. native: integer files keep their width (16 or packed 24 bit,
+    // lossless), float files stay float. compact: everything as 16 bit.
+    enum class Storage { float32, native, compact };
+    static constexpr juce::int64 streamingThresholdBytes = (juce::int64) 256 << 20;
+    static constexpr int maxStreamChannels = 8;
+    static constexpr int maxPlayHeads = 384; // preview + the largest voice bank
+    SamplePool() { formats.registerBasicFormats(); for (auto& h : playHeads) h.store (-1); }
+    ~SamplePool() { readAhead.stopThread (1000); }
+    // Opens 'file' and replaces the current sample with it: format and full length are
+    // known straight away, audio becomes readable as decodeNextChunk() publishes it.
+    // On failure the current sample is kept. Caller keeps the audio thread out.
+    // 'storage' applies to files decoded into RAM.
+    bool beginLoad (const juce::File& file, Storage storage = Storage::float32) {
+        readAhead.stopThread (1000);
+        if (auto m = openMapped (file)) {
+            const auto bytes = m->lengthInSamples * (juce::int64) m->numChannels * (juce::int64) sizeof (float);
+            if (bytes >= streamingThresholdBytes && (int) m->numChannels <= maxStreamChannels && m->mapEntireFile()) {
+                reader.reset(); buffer.setSize (pcm::Format::float32, 0, 0); mapped = std::move (m);
+                // Mapped audio is all readable at once; only the waveform is built in chunks
+                setFormat (file, mapped->sampleRate, (int) mapped->numChannels, mapped->lengthInSamples, mapped->lengthInSamples);
+                loadScratch.setSize (numChannels, loadChunkSamples);
+                clearPlayHeads(); readAhead.startThread();
+                resetConversion();
+                return true;
+            }
+        }
+        std::unique_ptr<juce::AudioFormatReader> r (formats.createReaderFor (file));
+        if (! r || r->lengthInSamples > std::numeric_limits<int>::max()) { // too long to hold in one buffer
+            if (mapped != nullptr) readAhead.startThread();
+            return false;
+        }
+        mapped.reset();
+        // Full size up front: decoded chunks never move
+        buffer.setSize (storageFormat (*r, storage), (int) r->numChannels, (int) r->lengthInSamples);
+        loadScratch.setSize ((int) r->numChannels, loadChunkSamples);
+        reader = std::move (r);
+        setFormat (file, reader->sampleRate, buffer.getNumChannels(), buffer.getNumSamples(), 0);
+        resetConversion();
+        return true;
+    }
+    // Loader thread, after beginLoad(): decodes the next chunk past the readable end,
+    // then publishes it to readers and to the waveform. False once the file is complete.
+    bool decodeNextChunk() {
+        if (complete.load()) return false;
+        // Mapped audio is readable already; with a restored waveform there is nothing left to do
+        if (mapped != nullptr && waveform.isRestored()) { finishLoad(); return false; }
+        const int n = (int) juce::jmin<juce::int64> (loadChunkSamples, fullLength - decodedTo);
+        if (mapped != nullptr) {
+            read (loadScratch, 0, decodedTo, n); waveform.append (loadScratch, 0, n);
+        } else {
+            reader->read (&loadScratch, 0, n, decodedTo, true, true);
+            for (int c = 0; c < numChannels; ++c) buffer.write (c, decodedTo, loadScratch.getReadPointer (c), n);
+            waveform.append (loadScratch, 0, n);
+            length.store (decodedTo + n);
+            const juce::ScopedLock sl (convertLock);
+            convertDecoded();
+        }
+        decodedTo += n;
+        if (decodedTo < fullLength) return true;
+        finishLoad();
+        return false;
+    }
+    // Realtime-safe: false while a load is still publishing chunks.
+    bool isFullyLoaded() const { return complete.load(); }
+    void clear() {
+        readAhead.stopThread (1000); mapped.reset(); reader.reset();
+        buffer.setSize (pcm::Format::float32, 0, 0); fileName.clear(); sampleRate = 44100.0; numChannels = 0; length.store (0); fullLength = 0;
+        waveform.reset (0); novelty.clear(); noveltyCoversFile.store (false); complete.store (true);
+        resetConversion();
+        const juce::ScopedLock sl (hotLock); hotRegions.clear();
+    }
+    bool isStreaming() const { return mapped != nullptr; }
+    // Readable length: grows chunk by chunk while a file loads. Realtime-safe.
+    juce::int64 getLengthInSamples() const { return length.load(); }
+    // Length once loading completes.
+    juce::int64 getFullLengthInSamples() const { return fullLength; }
+    // Length the analysis and slices cover: the readable length, or the whole file once the
+    // novelty curve does (restored from the analysis cache before the file has decoded).
+    // Realtime-safe.
+    juce::int64 getAnalysisLength() const { return noveltyCoversFile.load() ? fullLength : length.load(); }
+    // The novelty curve covers the whole file. Realtime-safe.
+    bool isAnalysed() const { return noveltyCoversFile.load(); }
+    int getNumChannels() const { return numChannels; }
     double getSampleRate() const { return sampleRate; }
     const juce::String& getName() const { return fileName; }
     const WaveformCache& getWaveform() const { return waveform; }
+    // Footprint of the RAM audio: file, playback copy and the conversions kept for other rates.
+    size_t getMemoryBytes() const {
+        const juce::ScopedLock sl (convertLock);
+        size_t bytes = buffer.getSizeInBytes() + playback.getSizeInBytes();
+        for (auto& c : convertedCache) bytes += c.second.getSizeInBytes();
+        return bytes;
+    }
+    // Not on the audio thread. Frees the conversions kept for other host rates (rebuilt if
+    // the host goes back to one); returns the bytes freed.
+    size_t dropCachedConversions() {
+        const juce::ScopedLock sl (convertLock);
+        size_t bytes = 0;
+        for (auto& c : convertedCache) bytes += c.second.getSizeInBytes();
+        convertedCache.clear();
+        return bytes;
+    }
+    // Not on the audio thread, and with it kept out (the engine calls this from prepare()).
+    // Playback reads run at hostRate from now on; true if that changed the playback audio.
+    bool setPlaybackRate (double hostRate) {
+        const juce::ScopedLock sl (convertLock);
+        const int rate = juce::roundToInt (hostRate);
+        if (rate == playbackRate) return false;
+        // Keep a finished conversion for when the host comes back to its rate
+        if (converted && playbackLength.load() == converter.outputLength (fullLength)) {
+            if (convertedCache.size() >= maxCachedRates) convertedCache.erase (convertedCache.begin());
+            convertedCache[playbackRate] = std::move (playback);
+        }
+        const bool wasOther = atOtherRate();
+        playbackRate = rate; startConversion();
+        return atOtherRate() || wasOther;
+    }
+    // Rate playback reads run at (0 before the first setPlaybackRate()). Same threading as
+    // setPlaybackRate(): read it with the audio thread kept out or under the engine locks.
+    int getPlaybackRate() const { return playbackRate; }
+    // Unique per pool for the life of the process, unlike its address.
+    juce::uint32 getId() const { return id; }
+    // Readable length in playback samples. Realtime-safe.
+    juce::int64 getPlaybackLength() const { return converted ? playbackLength.load() : streamResampled ? converter.outputLength (length.load()) : length.load(); }
+    // File sample <-> playback sample. Realtime-safe.
+    juce::int64 toPlayback (juce::int64 sourcePos) const { return atOtherRate() ? converter.toOutput (sourcePos) : sourcePos; }
+    juce::int64 toSource (juce::int64 playbackPos) const { return atOtherRate() ? converter.toInput (playbackPos) : playbackPos; }
+    // Realtime-safe. Two channel pointers (mono duplicated) to 'num' playback samples from
+    // 'start'; the caller keeps the range inside getPlaybackLength(). Resident float audio is
+    // returned in place; integer and streamed audio are converted into 'scratch'
+    // (num <= scratch.capacity()).
+    const float* const* getReadPointers (juce::int64 start, int num, SampleReadScratch& scratch) const {
+        if (mapped == nullptr) {
+            const auto& ram = converted ? playback : buffer;
+            const int outCh = juce::jmin (2, ram.getNumChannels());
+            if (ram.isFloat()) {
+                for (int c = 0; c < 2; ++c) scratch.ptrs[(size_t) c] = ram.getFloatPointer (juce::jmin (c, outCh - 1), start);
+                return scratch.ptrs.data();
+            }
+            jassert (num <= scratch.capacity());
+            num = juce::jmin (num, scratch.capacity());
+            for (int c = 0; c < outCh; ++c) ram.read (c, start, scratch.buffer.getWritePointer (c), num);
+            scratch.ptrs = { scratch.buffer.getReadPointer (0), scratch.buffer.getReadPointer (outCh - 1) };
+            return scratch.ptrs.data();
+        }
+        jassert (num <= scratch.capacity());
+        std::array<float*, 2> dest { scratch.buffer.getWritePointer (0), numChannels > 1 ? scratch.buffer.getWritePointer (1) : nullptr };
+        if (streamResampled) readMappedResampled (dest.data(), start, juce::jmin (num, scratch.capacity()), scratch.window);
+        else                 readMapped (dest.data(), 2, start, juce::jmin (num, scratch.capacity()));
+        scratch.ptrs = { dest[0], dest[1] != nullptr ? dest[1] : dest[0] };
+        return scratch.ptrs.data();
+    }
+    // Reversed view of playback [end-num, end): element k is sample end-1-k, copied into scratch
+    // (num <= capacity) with one block reverse per channel. Feeds reverse playback.
+    const float* const* getReversedReadPointers (juce::int64 end, int num, SampleReadScratch& scratch) const {
+        num = juce::jmin (num, scratch.capacity());
+        const int outCh = juce::jmin (2, juce::jmax (1, numChannels));
+        std::array<float*, 2> dest { scratch.buffer.getWritePointer (0), outCh > 1 ? scratch.buffer.getWritePointer (1) : nullptr };
+        if (mapped == nullptr) {
+            const auto& ram = converted ? playback : buffer;
+            for (int c = 0; c < outCh; ++c) {
+                if (ram.isFloat()) {
+                    const float* s = ram.getFloatPointer (c, end - num);
+                    std::reverse_copy (s, s + num, dest[(size_t) c]);
+                } else {
+                    ram.read (c, end - num, dest[(size_t) c], num);
+                    std::reverse (dest[(size_t) c], dest[(size_t) c] + num);
+                }
+            }
+        } else {
+            if (streamResampled) readMappedResampled (dest.data(), end - num, num, scratch.window);
+            else                 readMapped (dest.data(), 2, end - num, num);
+            for (int c = 0; c < outCh; ++c) std::reverse (dest[(size_t) c], dest[(size_t) c] + num);
+        }
+        scratch.ptrs = { scratch.buffer.getReadPointer (0), scratch.buffer.getReadPointer (outCh - 1) };
+        return scratch.ptrs.data();
+    }
+    // Copies [start, start+num) into dst from dstStart (mono duplicated, silence past the end).
+    void read (juce::AudioBuffer<float>& dst, int dstStart, juce::int64 start, int num) const {
+        if (numChannels == 0) { dst.clear (dstStart, num); return; }
+        if (mapped != nullptr) {
+            std::array<float*, maxStreamChannels> dest {};
+            for (int c = 0; c < juce::jmin (dst.getNumChannels(), numChannels); ++c) dest[(size_t) c] = dst.getWritePointer (c, dstStart);
+            readMapped (dest.data(), numChannels, start, num);
+        } else {
+            const int n = (int) juce::jlimit<juce::int64> (0, num, getLengthInSamples() - start);
+            for (int c = 0; c < juce::jmin (dst.getNumChannels(), numChannels); ++c) {
+                if (n > 0) buffer.read (c, start, dst.getWritePointer (c, dstStart), n);
+                if (n < num) dst.clear (c, dstStart + n, num - n);
+            }
+        }
+        for (int c = numChannels; c < dst.getNumChannels(); ++c) dst.copyFrom (c, dstStart, dst, 0, dstStart, num);
+    }
+    // read() in playback samples: [start, start+num) of what getReadPointers() plays.
+    void readPlayback (juce::AudioBuffer<float>& dst, int dstStart, juce::int64 start, int num) const {
+        if (streamResampled) {
+            juce::AudioBuffer<float> window (2, SampleReadScratch::windowSamples + SampleRateConverter::taps + 2);
+            std::array<float*, 2> dest { dst.getWritePointer (0, dstStart), numChannels > 1 && dst.getNumChannels() > 1 ? dst.getWritePointer (1, dstStart) : nullptr };
+            readMappedResampled (dest.data(), start, num, window);
+            for (int c = dest[1] != nullptr ? 2 : 1; c < dst.getNumChannels(); ++c) dst.copyFrom (c, dstStart, dst, 0, dstStart, num);
+            return;
+        }
+        if (! converted) { read (dst, dstStart, start, num); return; }
+        const int n = (int) juce::jlimit<juce::int64> (0, num, playbackLength.load() - start);
+        for (int c = 0; c < dst.getNumChannels(); ++c) {
+            if (n > 0) playback.read (juce::jmin (c, playback.getNumChannels() - 1), start, dst.getWritePointer (c, dstStart), n);
+            if (n < num) dst.clear (c, dstStart + n, num - n);
+        }
+    }
+    // Resident float audio at file sample 'start', read in place; nullptr for integer or
+    // streamed storage (use read()).
+    const float* getResidentPointer (int channel, juce::int64 start) const {
+        return mapped == nullptr && buffer.isFloat() && channel >= 0 && channel < numChannels ? buffer.getFloatPointer (channel, start) : nullptr;
+    }
+    // Mono view for the novelty pass; streamed and integer audio convert on demand from any thread.
+    AnalysisSource getAnalysisSource (int channel) const {
+        AnalysisSource src; src.numSamples = getLengthInSamples();
+        if (numChannels == 0) return src;
+        channel = juce::jlimit (0, numChannels - 1, channel);
+        if (mapped == nullptr && buffer.isFloat()) { src.data = buffer.getFloatPointer (channel, 0); return src; }
+        src.read = [this, channel] (float* dest, juce::int64 start, int num) {
+            if (mapped == nullptr) {
+                // Frames may run past the end: silence there, as in a float buffer
+                const int n = (int) juce::jlimit<juce::int64> (0, num, buffer.getNumSamples() - start);
+                buffer.read (channel, start, dest, n);
+                std::fill (dest + n, dest + num, 0.0f);
+                return;
+            }
+            std::array<float*, maxStreamChannels> d {}; d[(size_t) channel] = dest;
+            readMapped (d.data(), numChannels, start, num);
+        };
+        return src;
+    }
+    // Realtime-safe hint for the read-ahead thread: where play head 'slot' is, in playback
+    // samples (-1 = idle).
+    void setPlayHead (int slot, juce::int64 position) const {
+        if (slot >= 0 && slot < maxPlayHeads) playHeads[(size_t) slot].store (position, std::memory_order_relaxed);
+    }
+    // Regions kept warm while streaming, in file samples (slice heads, so note-ons don't fault).
+    void setHotRegions (std::vector<juce::Range<juce::int64>> regions) {
+        const juce::ScopedLock sl (hotLock); hotRegions = std::move (regions);
+    }
+    // Voices reading this sample (audio thread). SampleLibrary never evicts one in use.
+    void addVoice() const { voiceCount.fetch_add (1); }
+    void removeVoice() const { voiceCount.fetch_sub (1); }
+    bool hasVoices() const { return voiceCount.load() > 0; }
+    // Analysis cache for this buffer; filled lazily by the slicer's owner
+    const NoveltyCurve& getNovelty() const { return novelty; }
+    void setNovelty (NoveltyCurve n) {
+        noveltyCoversFile.store (n.isValid() && n.numSamples == fullLength && fullLength > 0);
+        novelty = std::move (n);
+    }
+    // Loader thread, straight after beginLoad(): the waveform levels and novelty curve
+    // saved for this file (AnalysisCache), so the overview and the slices are complete
+    // before the audio is. False, changing nothing, if they don't fit the file.
+    bool restoreAnalysis (int firstLevel, std::array<std::vector<WaveformCache::Bin>, WaveformCache::numLevels> levels, NoveltyCurve curve) {
+        if (curve.numSamples != fullLength || ! waveform.restore (fullLength, firstLevel, std::move (levels))) return false;
+        setNovelty (std::move (curve));
+        return true;
+    }
 private:
-    juce::AudioBuffer<float> buffer; double sampleRate { 44100.0 }; juce::String fileName; WaveformCache waveform;
+    static std::unique_ptr<juce::MemoryMappedAudioFormatReader> openMapped (const juce::File& file) {
+        if (file.hasFileExtension ("wav;bwf")) return std::unique_ptr<juce::MemoryMappedAudioFormatReader> (juce::WavAudioFormat().createMemoryMappedReader (file));
+        if (file.hasFileExtension ("aif;aiff")) return std::unique_ptr<juce::MemoryMappedAudioFormatReader> (juce::AiffAudioFormat().createMemoryMappedReader (file));
+        return {};
+    }
+    void setFormat (const juce::File& file, double rate, int channels, juce::int64 samples, juce::int64 readable) {
+        sampleRate = rate; numChannels = channels; fullLength = samples; length.store (readable); decodedTo = 0;
+        fileName = file.getFileNameWithoutExtension(); novelty.clear(); noveltyCoversFile.store (false);
+        waveform.reset (samples); complete.store (false);
+        if (samples == 0) finishLoad();
+        const juce::ScopedLock sl (hotLock); hotRegions.clear();
+    }
+    void finishLoad() { waveform.finish(); reader.reset(); complete.store (true); }
+    static pcm::Format storageFormat (const juce::AudioFormatReader& r, Storage storage) {
+        if (storage == Storage::compact) return pcm::Format::int16;
+        if (storage == Storage::native && ! r.usesFloatingPointData) {
+            if (r.bitsPerSample <= 16) return pcm::Format::int16;
+            if (r.bitsPerSample <= 24) return pcm::Format::int24;
+        }
+        return pcm::Format::float32;
+    }
+    // dest holds numDest (<= numChannels) channel pointers, nullptr for channels to skip.
+    // Reads straight from the map: no locks, no allocation.
+    void readMapped (float* const* dest, int numDest, juce::int64 start, int num) const {
+        std::array<int*, maxStreamChannels> ints {};
+        for (int c = 0; c < numDest; ++c) ints[(size_t) c] = reinterpret_cast<int*> (dest[c]);
+        mapped->read (ints.data(), numChannels, start, num, false);
+        if (! mapped->usesFloatingPointData)
+            for (int c = 0; c < numDest; ++c)
+                if (dest[c] != nullptr) juce::FloatVectorOperations::convertFixedToFloat (dest[c], ints[(size_t) c], 1.0f / (float) 0x7fffffff, num);
+    }
+    // Streamed file at another rate: playback [start, start+num) into dest (two channel
+    // pointers, the second nullptr for mono; silence past the end), converted from the map
+    // through 'window' a step at a time. No locks, no allocation.
+    void readMappedResampled (float* const* dest, juce::int64 start, int num, juce::AudioBuffer<float>& window) const {
+        const juce::int64 total = length.load();
+        const int chans = dest[1] != nullptr ? 2 : 1;
+        const int step = juce::jmax (1, (int) ((juce::int64) (window.getNumSamples() - SampleRateConverter::taps - 2) * playbackRate / juce::jmax (1, juce::roundToInt (sampleRate))));
+        std::array<float*, 2> w { window.getWritePointer (0), chans > 1 ? window.getWritePointer (1) : nullptr };
+        for (int done = 0; done < num;) {
+            const int m = juce::jmin (step, num - done);
+            const auto range = converter.inputRange (start + done, m, total);
+            readMapped (w.data(), chans, range.getStart(), (int) range.getLength());
+            std::array<float*, 2> out { dest[0] + done, chans > 1 ? dest[1] + done : nullptr };
+            const int n = converter.convert (window.getArrayOfReadPointers(), range.getStart(), chans, total, total, out.data(), start + done, m);
+            for (int c = 0; c < chans; ++c) std::fill (out[(size_t) c] + n, out[(size_t) c] + m, 0.0f);
+            done += m;
+        }
+    }
+    void clearPlayHeads() { for (auto& h : playHeads) h.store (-1); }
+    // A new file (or none): drop the old conversions, start this one's if needed.
+    void resetConversion() {
+        const juce::ScopedLock sl (convertLock);
+        convertedCache.clear(); startConversion();
+    }
+    // convertLock held. Sizes the playback copy for the file at playbackRate (or takes the
+    // cached one) and converts what is decoded so far.
+    void startConversion() {
+        const bool otherRate = numChannels > 0 && playbackRate > 0 && playbackRate != juce::roundToInt (sampleRate);
+        converted = otherRate && mapped == nullptr; streamResampled = otherRate && mapped != nullptr;
+        playbackLength.store (0);
+        if (otherRate) converter.prepare (juce::roundToInt (sampleRate), playbackRate);
+        if (! converted) { playback.setSize (pcm::Format::float32, 0, 0); return; }
+        if (auto it = convertedCache.find (playbackRate); it != convertedCache.end()) {
+            playback = std::move (it->second); convertedCache.erase (it);
+            playbackLength.store (playback.getNumSamples());
+            return;
+        }
+        // Playback reads at most two channels, stored like the file
+        playback.setSize (buffer.getFormat(), juce::jmin (2, numChannels), (int) juce::jmin<juce::int64> (converter.outputLength (fullLength), std::numeric_limits<int>::max()));
+        convertDecoded();
+    }
+    // convertLock held. Extends the playback copy as far as the decoded audio allows, a
+    // float window of the file at a time.
+    void convertDecoded() {
+        if (! converted) return;
+        const juce::int64 available = getLengthInSamples();
+        const int chans = playback.getNumChannels();
+        for (;;) {
+            const juce::int64 done = playbackLength.load();
+            const int num = (int) juce::jmin<juce::int64> (convertChunkSamples, playback.getNumSamples() - done);
+            if (num <= 0) return;
+            const auto range = converter.inputRange (done, num, available);
+            const int windowLength = (int) range.getLength();
+            convertWindow.setSize (chans, juce::jmax (1, windowLength), false, false, true);
+            convertOut.setSize (chans, num, false, false, true);
+            for (int c = 0; c < chans; ++c) buffer.read (c, range.getStart(), convertWindow.getWritePointer (c), windowLength);
+            const int n = converter.convert (convertWindow.getArrayOfReadPointers(), range.getStart(), chans, available, fullLength,
+                                             convertOut.getArrayOfWritePointers(), done, num);
+            for (int c = 0; c < chans; ++c) playback.write (c, done, convertOut.getReadPointer (c), n);
+            playbackLength.store (done + n);
+            if (n < num) return;
+        }
+    }
+    // Touches one sample per page ahead of every play head and in every hot region.
+    void touchAhead() {
+        const int bytesPerFrame = juce::jmax (1, numChannels * (int) mapped->bitsPerSample / 8);
+        const juce::int64 pageFrames = juce::jmax (1, 4096 / bytesPerFrame);
+        const auto ahead = (juce::int64) (sampleRate * readAheadSeconds);
+        const juce::int64 end = getLengthInSamples();
+        auto touch = [&] (juce::int64 from, juce::int64 to) {
+            for (auto s = juce::jmax<juce::int64> (0, from); s < juce::jmin (end, to); s += pageFrames) mapped->touchSample (s);
+        };
+        for (auto& h : playHeads) { const auto p = h.load (std::memory_order_relaxed); if (p >= 0) touch (toSource (p), toSource (p) + ahead); }
+        const juce::ScopedLock sl (hotLock);
+        for (auto r : hotRegions) touch (r.getStart(), r.getEnd());
+    }
+    struct ReadAhead : juce::Thread {
+        explicit ReadAhead (SamplePool& p) : juce::Thread ("Sample read-ahead"), pool (p) {}
+        void run() override { while (! threadShouldExit()) { pool.touchAhead(); wait (readAheadIntervalMs); } }
+        SamplePool& pool;
+    };
+    static constexpr int loadChunkSamples = 1 << 16; // ~1.5 s at 44.1 kHz
+    static constexpr int convertChunkSamples = 1 << 15;
+    static constexpr int readAheadIntervalMs = 20;
+    static constexpr double readAheadSeconds = 0.5;
+    PcmBuffer buffer; std::unique_ptr<juce::MemoryMappedAudioFormatReader> mapped;
+    double sampleRate { 44100.0 }; int numChannels { 0 }; std::atomic<juce::int64> length { 0 }; juce::int64 fullLength { 0 };
+    // In-progress load (loader thread only)
+    juce::AudioFormatManager formats; std::unique_ptr<juce::AudioFormatReader> reader;
+    juce::int64 decodedTo { 0 }; juce::AudioBuffer<float> loadScratch; std::atomic<bool> complete { true };
+    juce::String fileName; WaveformCache waveform;
+    NoveltyCurve novelty; std::atomic<bool> noveltyCoversFile { false };
+    mutable std::array<std::atomic<juce::int64>, maxPlayHeads> playHeads; mutable std::atomic<int> voiceCount { 0 };
+    juce::CriticalSection hotLock; std::vector<juce::Range<juce::int64>> hotRegions;
+    // Host-rate playback copy (guarded by convertLock; the audio thread reads it lock-free
+    // below playbackLength, and is kept out while it is replaced)
+    static constexpr size_t maxCachedRates = 2;
+    // converted: RAM file with a playback copy; streamResampled: streamed file converted on read
+    int playbackRate { 0 }; bool converted { false }, streamResampled { false }; SampleRateConverter converter;
+    bool atOtherRate() const { return converted || streamResampled; }
+    const juce::uint32 id { [] { static std::atomic<juce::uint32> next { 0 }; return ++next; }() };
+    PcmBuffer playback; std::atomic<juce::int64> playbackLength { 0 };
+    std::map<int, PcmBuffer> convertedCache; juce::CriticalSection convertLock;
+    juce::AudioBuffer<float> convertWindow, convertOut;
+    ReadAhead readAhead { *this };
 };
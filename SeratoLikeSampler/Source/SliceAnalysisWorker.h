@@ -0,0 +1,77 @@
+
+#pragma once
+#include <juce_core/juce_core.h>
+#include <atomic>
+#include <functional>
+#include "Slicer.h"
+#include "SamplePool.h"
+
+// Background thread that owns the spectral-flux slicer.
+// The audio thread posts slice controls with requestControls() (atomics only, no
+// locks or wakeups); the worker polls, coalesces bursts of changes into the latest
+// values and hands them to the engine's handler, which re-slices and publishes a
+// new slice table. The optional poll handler runs on every wake-up for other queued
+// work (slice edits). detect() lets loader/editor threads run the slicer synchronously.
+class SliceAnalysisWorker : private juce::Thread {
+public:
+    struct Controls { int baseNote { 36 }; int maxSlices { 64 }; float sensitivity { 1.2f }; bool medianThreshold { false }; };
+
+    SliceAnalysisWorker() : juce::Thread ("Slice analysis") {}
+    ~SliceAnalysisWorker() override { stop(); }
+
+    // pollToUse returns true when it did work, so the worker checks again straight away.
+    void start (std::function<void (const Controls&)> handlerToUse, std::function<bool()> pollToUse = {}) {
+        handler = std::move (handlerToUse); poll = std::move (pollToUse);
+        startThread();
+    }
+    void stop() { stopThread (2000); }
+
+    void prepare (double sampleRate) {
+        const juce::ScopedLock sl (slicerLock);
+        slicer.prepare (sampleRate);
+    }
+    // Realtime-safe: records the latest controls for the worker to pick up.
+    void requestControls (int baseNote, int maxSlices, float sensitivity, bool medianThreshold) {
+        if (reqBaseNote.load() == baseNote && reqMaxSlices.load() == maxSlices && reqSensitivity.load() == sensitivity
+            && reqMedian.load() == medianThreshold)
+            return;
+        reqBaseNote.store (baseNote); reqMaxSlices.store (maxSlices); reqSensitivity.store (sensitivity); reqMedian.store (medianThreshold);
+        requestSerial.fetch_add (1);
+    }
+    // Synchronous onset detection on the calling (non-audio) thread. The novelty curve
+    // is cached on the pool entry, so only the first call per buffer pays for the FFT
+    // pass; later calls are a peak re-pick. Caller keeps the pool stable (analysisLock).
+    // While a file is loading this analyses the part decoded so far, unless a curve for the
+    // whole file was restored from the analysis cache.
+    std::vector<SlicePoint> detect (SamplePool& pool, float sensitivity, bool medianThreshold, int targetSlices) {
+        const juce::ScopedLock sl (slicerLock);
+        if (! pool.getNovelty().matches (slicer.getFftOrder(), slicer.getHopSize(), 0, pool.getAnalysisLength())) {
+            NoveltyCurve curve; slicer.computeNovelty (pool.getAnalysisSource (0), 0, curve);
+            pool.setNovelty (std::move (curve));
+        }
+        slicer.setThresholdScale (sensitivity);
+        slicer.setThresholdMode (medianThreshold ? SpectralFluxSlicer::ThresholdMode::median : SpectralFluxSlicer::ThresholdMode::mean);
+        return slicer.pickPeaks (pool.getNovelty(), targetSlices);
+    }
+
+private:
+    void run() override {
+        int served = 0;
+        while (! threadShouldExit()) {
+            const int serial = requestSerial.load();
+            if (serial != served && handler) {
+                served = serial;
+                const Controls c { reqBaseNote.load(), reqMaxSlices.load(), reqSensitivity.load(), reqMedian.load() };
+                handler (c);
+                continue; // pick up anything that arrived while we were slicing
+            }
+            if (poll && poll()) continue;
+            wait (pollIntervalMs);
+        }
+    }
+    static constexpr int pollIntervalMs = 10;
+    std::function<void (const Controls&)> handler; std::function<bool()> poll;
+    juce::CriticalSection slicerLock; SpectralFluxSlicer slicer;
+    std::atomic<int> reqBaseNote { 36 }; std::atomic<int> reqMaxSlices { 64 }; std::atomic<float> reqSensitivity { 1.2f }; std::atomic<bool> reqMedian { false };
+    std::atomic<int> requestSerial { 0 };
+};
@@ -0,0 +1,189 @@
+#pragma once
+#include <juce_audio_formats/juce_audio_formats.h>
+#include <atomic>
+#include <deque>
+#include <map>
+#include <memory>
+#include <vector>
+#include "PadVoice.h"
+
+// Writes slices out as 24-bit WAVs in the background. Readers on a thread pool take
+// slices in turn and cut each into blocks: pointers straight into the sample's audio when
+// it is resident float and not normalised (no copy), otherwise converted (and scaled) into
+// the block. Blocks go through a bounded queue to writer threads, a slice always to the
+// same writer so its blocks stay in order; writers encode and write. Blocks come from a
+// fixed set, so readers wait on the writers once all are in flight: memory stays the same
+// for any export size and the disk sets the pace.
+// Driven from the message thread: start(), then poll getProgress()/isRunning().
+class SliceExporter : private juce::Thread {
+public:
+    struct Job {
+        std::shared_ptr<const SamplePool> source; // kept alive (and out of eviction) until done
+        std::vector<PadSlice> slices; juce::File folder; bool normalise { false };
+    };
+    SliceExporter() : juce::Thread ("Slice export") {}
+    ~SliceExporter() override { cancel(); stopThread (10000); }
+    // False while an export is running.
+    bool start (Job newJob) {
+        if (isRunning()) return false;
+        stopThread (1000); // the previous run has finished; join it
+        job = std::move (newJob);
+        cancelled.store (false); written.store (0); failed.store (0); samplesDone.store (0); totalSamples = 0;
+        for (auto& s : job.slices) totalSamples += juce::jmax (0, s.endSample - s.startSample);
+        running.store (true);
+        startThread();
+        return true;
+    }
+    // Stops at the next block; files left half-written are deleted.
+    void cancel() { cancelled.store (true); }
+    bool isRunning() const { return running.load(); }
+    bool wasCancelled() const { return cancelled.load(); }
+    // 0..1 of the audio written.
+    float getProgress() const { return totalSamples > 0 ? (float) ((double) samplesDone.load() / (double) totalSamples) : 1.0f; }
+    int getNumWritten() const { return written.load(); }
+    int getNumFailed() const { return failed.load(); }
+
+private:
+    static constexpr int blockSamples = 1 << 16;
+    struct Block {
+        int slice { -1 }, num { 0 }; bool last { false };
+        std::vector<const float*> channels; // into the sample's audio, or into 'audio'
+        juce::AudioBuffer<float> audio;     // sized on first use
+    };
+    // Encodes and writes the blocks queued to it, a file per slice.
+    struct Writer : juce::Thread {
+        explicit Writer (SliceExporter& e) : juce::Thread ("Slice export writer"), owner (e) {}
+        void push (Block* b) { { const juce::ScopedLock sl (lock); queue.push_back (b); } queued.signal(); }
+        void finish() { done.store (true); queued.signal(); }
+        void run() override {
+            for (;;) {
+                Block* b = nullptr;
+                {
+                    const juce::ScopedLock sl (lock);
+                    if (! queue.empty()) { b = queue.front(); queue.pop_front(); }
+                }
+                if (b == nullptr) {
+                    if (done.load()) break;
+                    queued.wait (50);
+                    continue;
+                }
+                write (*b);
+                owner.release (b);
+            }
+            for (auto& f : open) { f.second.writer.reset(); f.second.file.deleteFile(); } // cancelled mid-slice
+        }
+        void write (const Block& b) {
+            auto& f = open[b.slice];
+            if (f.writer == nullptr && ! f.failed && ! owner.cancelled.load()) {
+                f.file = owner.fileFor (b.slice); f.writer = owner.createWriter (f.file);
+                f.failed = f.writer == nullptr;
+            }
+            if (f.writer != nullptr && ! f.failed && ! owner.cancelled.load())
+                f.failed = ! f.writer->writeFromFloatArrays (b.channels.data(), (int) b.channels.size(), b.num);
+            owner.samplesDone.fetch_add (b.num);
+            if (! b.last) return;
+            const bool ok = f.writer != nullptr && ! f.failed && ! owner.cancelled.load();
+            f.writer.reset(); // flushes the header
+            if (ok) owner.written.fetch_add (1);
+            else { f.file.deleteFile(); if (! owner.cancelled.load()) owner.failed.fetch_add (1); }
+            open.erase (b.slice);
+        }
+        struct OpenFile { juce::File file; std::unique_ptr<juce::AudioFormatWriter> writer; bool failed { false }; };
+        SliceExporter& owner; juce::CriticalSection lock; std::deque<Block*> queue; juce::WaitableEvent queued;
+        std::atomic<bool> done { false }; std::map<int, OpenFile> open;
+    };
+
+    void run() override {
+        const int cpus = juce::jmax (1, juce::SystemStats::getNumCpus());
+        const int numWriters = juce::jlimit (1, 4, cpus / 2), numReaders = juce::jmax (1, cpus - numWriters);
+        blocks.clear(); blocks.resize ((size_t) (2 * (numReaders + numWriters)));
+        freeBlocks.clear();
+        for (auto& b : blocks) { b.channels.resize ((size_t) job.source->getNumChannels()); freeBlocks.push_back (&b); }
+        writers.clear();
+        for (int w = 0; w < numWriters; ++w) { writers.push_back (std::make_unique<Writer> (*this)); writers.back()->startThread(); }
+        if (readers == nullptr || readers->getNumThreads() != numReaders) readers = std::make_unique<juce::ThreadPool> (numReaders);
+        std::atomic<int> nextSlice { 0 }, remaining { numReaders }; juce::WaitableEvent readersDone;
+        for (int r = 0; r < numReaders; ++r)
+            readers->addJob ([this, &nextSlice, &remaining, &readersDone] {
+                juce::AudioBuffer<float> scratch; // peak scan of converted audio
+                for (int k; ! cancelled.load() && (k = nextSlice.fetch_add (1)) < (int) job.slices.size();)
+                    readSlice (k, scratch);
+                if (remaining.fetch_sub (1) == 1) readersDone.signal();
+            });
+        readersDone.wait();
+        for (auto& w : writers) w->finish();
+        for (auto& w : writers) w->stopThread (-1); // returns once its queue is drained
+        writers.clear();
+        job.source.reset();
+        running.store (false);
+    }
+    // Reader thread: queues slice k block by block to its writer.
+    void readSlice (int k, juce::AudioBuffer<float>& scratch) {
+        const auto& src = *job.source; const auto& s = job.slices[(size_t) k];
+        const int n = juce::jmax (0, s.endSample - s.startSample), chans = src.getNumChannels();
+        if (n == 0 || chans == 0) return;
+        const bool resident = src.getResidentPointer (0, 0) != nullptr;
+        float gain = 1.0f;
+        if (job.normalise) {
+            float peak = 0.0f;
+            for (int pos = 0; pos < n; pos += blockSamples) {
+                const int num = juce::jmin (blockSamples, n - pos);
+                if (! resident) { scratch.setSize (chans, blockSamples, false, false, true); src.read (scratch, 0, s.startSample + pos, num); }
+                for (int c = 0; c < chans; ++c) {
+                    const float* p = resident ? src.getResidentPointer (c, s.startSample + pos) : scratch.getReadPointer (c);
+                    const auto range = juce::FloatVectorOperations::findMinAndMax (p, num);
+                    peak = juce::jmax (peak, -range.getStart(), range.getEnd());
+                }
+            }
+            if (peak > 0.00001f) gain = 0.999f / peak;
+        }
+        for (int pos = 0; pos < n && ! cancelled.load();) {
+            Block* b = acquire();
+            if (b == nullptr) return; // cancelled
+            b->slice = k; b->num = juce::jmin (blockSamples, n - pos); b->last = pos + b->num >= n;
+            if (resident && gain == 1.0f) {
+                for (int c = 0; c < chans; ++c) b->channels[(size_t) c] = src.getResidentPointer (c, s.startSample + pos);
+            } else {
+                b->audio.setSize (chans, blockSamples, false, false, true);
+                src.read (b->audio, 0, s.startSample + pos, b->num);
+                if (gain != 1.0f) b->audio.applyGain (0, b->num, gain);
+                for (int c = 0; c < chans; ++c) b->channels[(size_t) c] = b->audio.getReadPointer (c);
+            }
+            pos += b->num;
+            writers[(size_t) k % writers.size()]->push (b);
+        }
+    }
+    // A free block, waiting for the writers to return one; nullptr once cancelled.
+    Block* acquire() {
+        for (;;) {
+            {
+                const juce::ScopedLock sl (blockLock);
+                if (! freeBlocks.empty()) { auto* b = freeBlocks.back(); freeBlocks.pop_back(); return b; }
+            }
+            if (cancelled.load()) return nullptr;
+            blockFreed.wait (50);
+        }
+    }
+    void release (Block* b) { { const juce::ScopedLock sl (blockLock); freeBlocks.push_back (b); } blockFreed.signal(); }
+    juce::File fileFor (int k) const {
+        static const char* names[12] = {"C","C#","D","D#","E","F","F#","G","G#","A","A#","B"};
+        const auto& s = job.slices[(size_t) k];
+        const int octave = (s.midiNote / 12) - 1; const char* nm = names[s.midiNote % 12];
+        return job.folder.getChildFile (juce::String::formatted ("%03d_%s%d_%d_%d.wav", k, nm, octave, s.startSample, s.endSample));
+    }
+    std::unique_ptr<juce::AudioFormatWriter> createWriter (const juce::File& file) const {
+        file.deleteFile(); // FileOutputStream appends to an existing file
+        std::unique_ptr<juce::FileOutputStream> os (file.createOutputStream());
+        if (os == nullptr || ! os->openedOk()) return {};
+        std::unique_ptr<juce::AudioFormatWriter> w (juce::WavAudioFormat().createWriterFor (os.get(), job.source->getSampleRate(), (unsigned int) job.source->getNumChannels(), 24, {}, 0));
+        if (w != nullptr) os.release(); // owned by the writer now
+        return w;
+    }
+
+    Job job; juce::int64 totalSamples { 0 };
+    std::atomic<bool> running { false }, cancelled { false };
+    std::atomic<int> written { 0 }, failed { 0 }; std::atomic<juce::int64> samplesDone { 0 };
+    std::vector<Block> blocks; std::vector<Block*> freeBlocks; juce::CriticalSection blockLock; juce::WaitableEvent blockFreed;
+    std::vector<std::unique_ptr<Writer>> writers;
+    std::unique_ptr<juce::ThreadPool> readers;
+};
@@ -20,6 +20,7 @@ public:
             if (r.pitch) { r.pitch->setBounds (x, y + 4, 80, rowH - 8); x += 84; }
             if (r.ratio) { r.ratio->setBounds (x, y + 4, 90, rowH - 8); x += 94; }
             if (r.reverse) { r.reverse->setBounds (x, y + 4, 72, rowH - 8); x += 74; }
+            if (r.choke) { r.choke->setBounds (x, y + 4, 64, rowH - 8); x += 68; }
             // Remaining width for gain bar
             r.gain->setBounds (x, y + 2, juce::jmax (40, getWidth() - x - pad), rowH - 4);
             y += rowH;
@@ -27,7 +28,7 @@ public:
     }
     void timerCallback() override {
         auto& engine = processor.getEngine();
-        auto count = engine.getSlices().size();
+        auto count = (size_t) engine.getNumSlices();
         if (count != lastCount) rebuild();
         // keep values in sync in case engine updated externally
         for (size_t i = 0; i < rows.size(); ++i) {
@@ -42,6 +43,9 @@ public:
             bool rev = engine.getSliceReverse ((int) i);
             if (rows[i].reverse && rows[i].reverse->getToggleState() != rev)
                 rows[i].reverse->setToggleState (rev, juce::dontSendNotification);
+            int group = engine.getSliceChokeGroup ((int) i);
+            if (rows[i].choke && rows[i].choke->getSelectedId() != group + 1)
+                rows[i].choke->setSelectedId (group + 1, juce::dontSendNotification);
         }
     }
 private:
@@ -49,12 +53,13 @@ private:
         std::unique_ptr<juce::Label> idx, note, time;
         std::unique_ptr<juce::Slider> gain, pitch, ratio;
         std::unique_ptr<juce::ToggleButton> reverse;
+        std::unique_ptr<juce::ComboBox> choke;
     };
     void rebuild() {
         rows.clear();
         removeAllChildren();
         auto& engine = processor.getEngine();
-        const auto& slices = engine.getSlices();
+        const auto slices = engine.getSlices();
         rows.resize (slices.size());
         for (size_t i = 0; i < slices.size(); ++i) {
             const auto& s = slices[i];
@@ -65,12 +70,14 @@ private:
             rows[i].pitch = std::make_unique<juce::Slider>();
             rows[i].ratio = std::make_unique<juce::Slider>();
             rows[i].reverse = std::make_unique<juce::ToggleButton>("Rev");
+            rows[i].choke = std::make_unique<juce::ComboBox>();
             addAndMakeVisible (*rows[i].idx);
             addAndMakeVisible (*rows[i].note);
             addAndMakeVisible (*rows[i].time);
             addAndMakeVisible (*rows[i].pitch);
             addAndMakeVisible (*rows[i].ratio);
             addAndMakeVisible (*rows[i].reverse);
+            addAndMakeVisible (*rows[i].choke);
             addAndMakeVisible (*rows[i].gain);
             rows[i].idx->setText (juce::String ((int) i), juce::dontSendNotification);
             static const char* names[12] = {"C","C#","D","D#","E","F","F#","G","G#","A","A#","B"};
@@ -97,6 +104,12 @@ private:
             auto* rb = rows[i].reverse.get();
             rb->setToggleState (engine.getSliceReverse ((int) i), juce::dontSendNotification);
             rb->onClick = [idx = (int) i, rb, &engine](){ engine.setSliceReverse (idx, rb->getToggleState()); };
+            // Choke group (item id = group + 1; group 0 = none)
+            auto* cb = rows[i].choke.get();
+            cb->addItem ("-", 1);
+            for (int g = 1; g <= PadSlice::maxChokeGroups; ++g) cb->addItem ("C" + juce::String (g), g + 1);
+            cb->setSelectedId (engine.getSliceChokeGroup ((int) i) + 1, juce::dontSendNotification);
+            cb->onChange = [idx = (int) i, cb, &engine](){ engine.setSliceChokeGroup (idx, cb->getSelectedId() - 1); };
         }
         lastCount = slices.size();
         setSize (getWidth(), (int) (rows.size() * 28 + 2));
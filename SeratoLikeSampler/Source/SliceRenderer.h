@@ -0,0 +1,129 @@
+#pragma once
+#include <juce_core/juce_core.h>
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <memory>
+#include <tuple>
+#include <vector>
+#include "PadVoice.h"
+
+// Background renderer for slices with static pitch, time or reverse settings. Voices
+// playing such a slice read its finished render like a plain sample instead of running a
+// stretcher each, so the stretch is paid once per setting instead of once per note.
+// The engine asks for renders while it publishes a slice table (find); missing ones are
+// queued and rendered here, then onReady lets the engine publish a table that points at
+// them. Until then voices stretch live. Renders are kept alive by the tables referencing
+// them and by the voices playing them, and are freed only on writer threads.
+class SliceRenderer : private juce::Thread {
+public:
+    struct Key {
+        // The file by address, by id (an address can be reused after eviction) and at the
+        // playback rate its slices are read at
+        const SamplePool* source { nullptr }; juce::uint32 sourceId { 0 }; int rate { 0 }; int start { 0 }, end { 0 };
+        float timeRatio { 1.0f }, semitones { 0.0f }; bool reverse { false };
+        TimePitchEngine::Backend backend { TimePitchEngine::Backend::resample };
+        auto tie() const { return std::tie (source, sourceId, rate, start, end, timeRatio, semitones, reverse, backend); }
+        bool operator< (const Key& o) const { return tie() < o.tie(); }
+        bool operator== (const Key& o) const { return tie() == o.tie(); }
+    };
+    // Copies the slice audio for the key into dest (stereo); false if that audio is gone.
+    using Source = std::function<bool (const Key&, juce::AudioBuffer<float>& dest)>;
+
+    SliceRenderer() : juce::Thread ("Slice renderer") {}
+    ~SliceRenderer() override { stop(); }
+    void start (Source sourceToUse, std::function<void()> onReadyToUse) {
+        source = std::move (sourceToUse); onReady = std::move (onReadyToUse);
+        startThread();
+    }
+    void stop() { stopThread (4000); }
+    void prepare (double sampleRate) { const juce::ScopedLock sl (lock); sr = sampleRate; }
+
+    static bool wants (const PadSlice& s) { return s.reverse || s.timeRatio != 1.0f || s.pitchSemitones != 0.0f; }
+    // s.source must be set.
+    static Key keyFor (const PadSlice& s, TimePitchEngine::Backend backend) {
+        const bool stretched = s.timeRatio != 1.0f || s.pitchSemitones != 0.0f;
+        return { s.source, s.source->getId(), s.source->getPlaybackRate(), s.startSample, s.endSample, s.timeRatio, s.pitchSemitones, s.reverse, stretched ? backend : TimePitchEngine::Backend::resample };
+    }
+    // Writer side: the finished render for key, or nullptr after queueing it.
+    std::shared_ptr<const SliceRender> find (const Key& key) {
+        const juce::ScopedLock sl (lock);
+        if (auto it = renders.find (key); it != renders.end()) return it->second;
+        if (std::find (pending.begin(), pending.end(), key) == pending.end()) { pending.push_back (key); notify(); }
+        return nullptr;
+    }
+    // Writer side: drops queued keys and unused renders that the latest table doesn't want.
+    void retainOnly (const std::vector<Key>& wanted) {
+        const juce::ScopedLock sl (lock);
+        const auto isWanted = [&wanted] (const Key& k) { return std::find (wanted.begin(), wanted.end(), k) != wanted.end(); };
+        pending.erase (std::remove_if (pending.begin(), pending.end(), [&] (const Key& k) { return ! isWanted (k); }), pending.end());
+        for (auto it = renders.begin(); it != renders.end();) {
+            // use_count 1: no published table holds it, and none can get it without this lock
+            const bool unused = it->second.use_count() == 1 && it->second->users.load() == 0;
+            it = unused && ! isWanted (it->first) ? renders.erase (it) : std::next (it);
+        }
+    }
+
+private:
+    void run() override {
+        while (! threadShouldExit()) {
+            Key key; double rate = 44100.0;
+            {
+                const juce::ScopedLock sl (lock);
+                if (pending.empty()) key.end = -1; else { key = pending.front(); rate = sr; }
+            }
+            if (key.end < 0) { wait (-1); continue; }
+            auto r = std::make_shared<SliceRender>();
+            const bool ok = source && source (key, r->audio) && render (key, rate, r->audio);
+            {
+                const juce::ScopedLock sl (lock);
+                const auto it = std::find (pending.begin(), pending.end(), key);
+                if (it == pending.end()) continue;   // no longer wanted
+                pending.erase (it);
+                if (! ok) continue;
+                renders[key] = std::move (r);
+            }
+            if (onReady) onReady();
+        }
+    }
+    // Reverses and/or stretches audio in place with the key's backend (sinc when resampling).
+    bool render (const Key& key, double rate, juce::AudioBuffer<float>& audio) {
+        const int n = audio.getNumSamples();
+        if (n <= 0) return false;
+        if (key.reverse) audio.reverse (0, n);
+        if (key.timeRatio == 1.0f && key.semitones == 0.0f) return true;
+        TimeStretcher stretcher; stretcher.prepare (rate, chunk);
+        stretcher.setBackend (key.backend); stretcher.setQuality (BlockResampler::Quality::sinc);
+        stretcher.setRatios (key.timeRatio, key.semitones); stretcher.reset();
+        const int total = juce::jmax (1, (int) std::round ((double) n / stretcher.getRate()));
+        // Offline there is no latency to wait out: prime with the lead-in, drop the delayed start
+        const float* lead[2] { audio.getReadPointer (0), audio.getReadPointer (1) };
+        int pos = stretcher.prime (lead, 2, n), skip = stretcher.getLatency();
+        juce::AudioBuffer<float> out (2, total), block (2, chunk);
+        int written = 0;
+        while (written < total && ! threadShouldExit()) {
+            if (pos >= n) {
+                // Input used up: the rest is the stretcher's held-back tail, not silence
+                const int rest = total - written + skip, dropped = juce::jmin (skip, rest);
+                juce::AudioBuffer<float> tail (2, rest);
+                stretcher.flush (tail.getArrayOfWritePointers(), 2, rest);
+                for (int c = 0; c < 2; ++c) out.copyFrom (c, written, tail, c, dropped, rest - dropped);
+                written = total;
+                break;
+            }
+            const int numOut = juce::jmin (chunk, total - written + skip);
+            const int available = juce::jmin (n - pos, stretcher.inputFor (numOut));
+            const float* in[2] { audio.getReadPointer (0, pos), audio.getReadPointer (1, pos) };
+            pos += stretcher.process (in, 2, available, numOut, block);
+            const int dropped = juce::jmin (skip, numOut);
+            for (int c = 0; c < 2; ++c) out.copyFrom (c, written, block, c, dropped, numOut - dropped);
+            written += numOut - dropped; skip -= dropped;
+        }
+        audio = std::move (out);
+        return ! threadShouldExit();
+    }
+    static constexpr int chunk = 4096;
+    Source source; std::function<void()> onReady;
+    juce::CriticalSection lock; double sr { 44100.0 };
+    std::vector<Key> pending; std::map<Key, std::shared_ptr<const SliceRender>> renders;
+};
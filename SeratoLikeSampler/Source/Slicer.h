@@ -2,33 +2,89 @@
 #pragma once
 #include <juce_dsp/juce_dsp.h>
 #include <vector>
+#include <set>
+#include <atomic>
+#include <functional>
+#include <limits>
+#include "DSP/Analysis/FluxKernel.h"
 struct SlicePoint { int sampleIndex = 0; };
+// Spectral-flux novelty for one buffer, tagged with the FFT config that produced it
+// and the number of samples it covers (a buffer that is still loading keeps growing).
+// Depends only on the audio and the FFT config, so it is computed once per loaded
+// buffer and reused for every re-pick (sensitivity, max slices, quantize).
+struct NoveltyCurve {
+    std::vector<float> values;
+    int fftOrder { 0 }, hopSize { 0 }, channel { -1 }; juce::int64 numSamples { 0 };
+    bool matches (int order, int hop, int ch, juce::int64 samples) const { return fftOrder == order && hopSize == hop && channel == ch && numSamples == samples; }
+    bool isValid() const { return channel >= 0; }
+    void clear() { values.clear(); fftOrder = hopSize = 0; channel = -1; numSamples = 0; }
+};
+// Mono input for the novelty pass: a resident channel, or a thread-safe reader that
+// decodes [start, start+num) on demand (memory-mapped files).
+struct AnalysisSource {
+    juce::int64 numSamples { 0 };
+    const float* data { nullptr };
+    std::function<void (float* dest, juce::int64 start, int num)> read;
+};
+// Running median over a sliding window (two balanced multisets, O(log w) per step).
+class SlidingMedian {
+public:
+    void insert (float v) {
+        if (lo.empty() || v <= *lo.rbegin()) lo.insert (v); else hi.insert (v);
+        rebalance();
+    }
+    void erase (float v) {
+        if (! lo.empty() && v <= *lo.rbegin()) lo.erase (lo.find (v)); else hi.erase (hi.find (v));
+        rebalance();
+    }
+    float median() const { return lo.empty() ? 0.0f : *lo.rbegin(); }
+private:
+    void rebalance() {
+        while (lo.size() > hi.size() + 1) { auto it = std::prev (lo.end()); hi.insert (*it); lo.erase (it); }
+        while (hi.size() > lo.size())     { auto it = hi.begin(); lo.insert (*it); hi.erase (it); }
+    }
+    std::multiset<float> lo, hi; // lo: lower half (holds the median), hi: upper half
+};
 class SpectralFluxSlicer {
 public:
+    SpectralFluxSlicer() { prepare (sr); }
+    // Mean: threshold = local mean * scale (default). Median: local median * scale,
+    // more robust to dense transients pulling the threshold up.
+    enum class ThresholdMode { mean, median };
     void prepare (double sampleRate, int fftOrder = 12, int hop = 512) {
         sr = sampleRate; order = fftOrder; fftSize = 1 << order; hopSize = hop;
         window.setSize (1, fftSize);
         for (int i = 0; i < fftSize; ++i)
             window.setSample (0, i, 0.5f * (1.f - std::cos(2.f * juce::MathConstants<float>::pi * (float)i / (float)(fftSize-1))));
-        fft = std::make_unique<juce::dsp::FFT>(order);
-        mag.resize (fftSize/2); prevMag.assign (fftSize/2, 0.0f);
     }
     void setThresholdScale (float s) { thresholdScale = s; }
     void setLocalWindow (int w)      { localWindow = juce::jlimit (4, 128, w); }
     void setHopSize (int hop)        { hopSize = juce::jmax (64, hop); }
+    void setThresholdMode (ThresholdMode m) { thresholdMode = m; }
+    int getFftOrder() const { return order; }
+    int getHopSize() const   { return hopSize; }
     std::vector<SlicePoint> slice (const juce::AudioBuffer<float>& buffer, int channel = 0, int targetSlices = 16) {
-        std::vector<float> novelty; computeNovelty (buffer, channel, novelty);
-        const int n = (int) novelty.size();
-        std::vector<int> peaks; const int w = localWindow;
-        for (int i = 1; i < n-1; ++i) {
-            float localMean = 0.f; int count = 0;
-            for (int k = -w; k <= w; ++k) { int idx = juce::jlimit (0, n-1, i+k); localMean += novelty[(size_t)idx]; ++count; }
-            localMean /= (float) count; float th = localMean * thresholdScale;
-            if (novelty[(size_t)i] > th && novelty[(size_t)i] > novelty[(size_t)i-1] && novelty[(size_t)i] > novelty[(size_t)i+1])
-                peaks.push_back (i);
-        }
+        NoveltyCurve curve; computeNovelty (buffer, channel, curve);
+        return pickPeaks (curve, targetSlices);
+    }
+    // Full FFT pass over the buffer (expensive; cache the result).
+    void computeNovelty (const juce::AudioBuffer<float>& buffer, int channel, NoveltyCurve& curve) {
+        AnalysisSource src; src.numSamples = buffer.getNumSamples();
+        if (buffer.getNumChannels() > 0) src.data = buffer.getReadPointer (juce::jmin (channel, buffer.getNumChannels()-1));
+        computeNovelty (src, channel, curve);
+    }
+    void computeNovelty (const AnalysisSource& src, int channel, NoveltyCurve& curve) {
+        computeNovelty (src, curve.values);
+        curve.fftOrder = order; curve.hopSize = hopSize; curve.channel = channel; curve.numSamples = src.numSamples;
+    }
+    // Adaptive-threshold peak picking over a novelty curve (cheap).
+    std::vector<SlicePoint> pickPeaks (const NoveltyCurve& curve, int targetSlices) const {
+        const auto& novelty = curve.values; const int hop = curve.hopSize;
+        std::vector<int> peaks;
+        if (thresholdMode == ThresholdMode::median) pickPeaksMedian (novelty, peaks);
+        else                                        pickPeaksMean (novelty, peaks);
         std::vector<SlicePoint> out; out.push_back({0});
-        for (int idx : peaks) { int sampleIdx = idx * hopSize; if (sampleIdx > 200) out.push_back({sampleIdx}); }
+        for (int idx : peaks) { int sampleIdx = idx * hop; if (sampleIdx > 200) out.push_back({sampleIdx}); }
         if ((int) out.size() > targetSlices) {
             std::vector<SlicePoint> reduced; float stride = (float) out.size() / (float) targetSlices;
             for (int i = 0; i < targetSlices; ++i)
@@ -38,32 +94,120 @@ public:
         return out;
     }
 private:
-    void computeNovelty (const juce::AudioBuffer<float>& buffer, int channel, std::vector<float>& novelty) {
-        novelty.clear(); if (buffer.getNumSamples() < fftSize) return;
-        tempBlock.setSize (1, fftSize);
-        juce::HeapBlock<float> fftData; fftData.allocate ((size_t)(2 * fftSize), true);
-        for (int pos = 0; pos + fftSize < buffer.getNumSamples(); pos += hopSize) {
-            for (int i = 0; i < fftSize; ++i) {
-                float w = window.getSample (0, i);
-                float x = buffer.getSample (juce::jmin (channel, buffer.getNumChannels()-1), pos + i);
-                fftData[i] = x * w;
-            }
-            for (int i = fftSize; i < 2*fftSize; ++i) fftData[i] = 0.0f;
-            fft->performRealOnlyForwardTransform (fftData.getData());
-            for (int k = 0; k < fftSize/2; ++k) {
-                float re = fftData[k]; float im = fftData[fftSize - k - 1];
-                mag[(size_t)k] = std::sqrt (re*re + im*im);
-            }
-            float flux = 0.0f;
-            for (int k = 0; k < fftSize/2; ++k) {
-                float d = mag[(size_t)k] - prevMag[(size_t)k];
-                if (d > 0) flux += d;
-                prevMag[(size_t)k] = mag[(size_t)k];
-            }
-            novelty.push_back (flux);
+    // Reference threshold: float mean over the edge-clamped window, summed in order.
+    float meanThreshold (const std::vector<float>& novelty, int i) const {
+        const int n = (int) novelty.size(); const int w = localWindow;
+        float localMean = 0.f; int count = 0;
+        for (int k = -w; k <= w; ++k) { int idx = juce::jlimit (0, n-1, i+k); localMean += novelty[(size_t)idx]; ++count; }
+        localMean /= (float) count; return localMean * thresholdScale;
+    }
+    static bool isLocalMax (const std::vector<float>& novelty, int i) {
+        return novelty[(size_t)i] > novelty[(size_t)i-1] && novelty[(size_t)i] > novelty[(size_t)i+1];
+    }
+    // O(n): window sums from double prefix sums. Frames whose novelty lies within the
+    // error bound of the float reference threshold are re-checked with meanThreshold(),
+    // so the picked peaks are identical to the O(n*w) reference.
+    void pickPeaksMean (const std::vector<float>& novelty, std::vector<int>& peaks) const {
+        const int n = (int) novelty.size(); const int w = localWindow; const int count = 2 * w + 1;
+        if (n < 3) return;
+        std::vector<double> prefix ((size_t) n + 1, 0.0);
+        for (int i = 0; i < n; ++i) prefix[(size_t) i + 1] = prefix[(size_t) i] + (double) novelty[(size_t) i];
+        const double first = novelty.front(), last = novelty.back();
+        // Novelty is non-negative: float summation error <= count * 2^-24 relative (1e-4 covers it),
+        // prefix-sum error <= 2n * 2^-53 * total absolute.
+        const double absTol = (double) thresholdScale * 4.0e-16 * (double) n * prefix[(size_t) n] / (double) count;
+        for (int i = 1; i < n-1; ++i) {
+            if (! isLocalMax (novelty, i)) continue;
+            const int lo = juce::jmax (0, i - w), hi = juce::jmin (n - 1, i + w);
+            const double sum = prefix[(size_t) hi + 1] - prefix[(size_t) lo]
+                             + (double) (lo - (i - w)) * first + (double) ((i + w) - hi) * last;
+            const double th = sum / (double) count * (double) thresholdScale;
+            const double v = novelty[(size_t) i];
+            const double tol = th * 1.0e-4 + absTol;
+            const bool above = v > th + tol ? true
+                             : v < th - tol ? false
+                             : novelty[(size_t) i] > meanThreshold (novelty, i);
+            if (above) peaks.push_back (i);
+        }
+    }
+    // O(n log w) sliding median over the same edge-clamped window.
+    void pickPeaksMedian (const std::vector<float>& novelty, std::vector<int>& peaks) const {
+        const int n = (int) novelty.size(); const int w = localWindow;
+        if (n < 3) return;
+        auto at = [&novelty, n] (int idx) { return novelty[(size_t) juce::jlimit (0, n-1, idx)]; };
+        SlidingMedian window;
+        for (int k = -w; k <= w; ++k) window.insert (at (1 + k));
+        for (int i = 1; i < n-1; ++i) {
+            if (i > 1) { window.erase (at (i - 1 - w)); window.insert (at (i + w)); }
+            if (isLocalMax (novelty, i) && novelty[(size_t) i] > window.median() * thresholdScale)
+                peaks.push_back (i);
+        }
+    }
+    // Per-thread FFT state for a run of consecutive frames.
+    struct FluxState {
+        explicit FluxState (int fftOrder) : fft (fftOrder), size (1 << fftOrder) {
+            fftData.allocate ((size_t) (2 * size), true);
+            prevMag.assign ((size_t) size / 2, 0.0f);
+        }
+        juce::dsp::FFT fft; int size; juce::HeapBlock<float> fftData; std::vector<float> prevMag;
+    };
+    static int numFrames (int numSamples, int size, int hop) { return numSamples > size ? (numSamples - size - 1) / hop + 1 : 0; }
+    // Windows the frame at 'pos' straight from the channel pointer, transforms it, then
+    // runs the fused magnitude/flux kernel (which also advances prevMag).
+    float analyseFrame (FluxState& st, const float* src, int pos) const {
+        float* data = st.fftData.getData();
+        juce::FloatVectorOperations::multiply (data, src + pos, window.getReadPointer (0), fftSize);
+        juce::FloatVectorOperations::clear (data + fftSize, fftSize);
+        st.fft.performRealOnlyForwardTransform (data);
+        return flux::get() (data, fftSize, st.prevMag.data());
+    }
+    // Frames [f0, f1). prevMag is seeded from frame f0-1 (the overlap region), so any
+    // split of the frame range yields exactly the serial curve.
+    void computeRange (const AnalysisSource& src, int f0, int f1, float* out) const {
+        FluxState st (order);
+        const int first = f0 > 0 ? f0 - 1 : 0; // frame f0-1 only seeds prevMag
+        if (src.data != nullptr) {
+            for (int f = first; f < f1; ++f) { const float v = analyseFrame (st, src.data, f * hopSize); if (f >= f0) out[f - f0] = v; }
+            return;
+        }
+        // Streamed: decode framesPerRead frames (plus the FFT overlap) at a time
+        std::vector<float> block;
+        for (int b = first; b < f1; b += framesPerRead) {
+            const int e = juce::jmin (f1, b + framesPerRead);
+            block.resize ((size_t) ((e - 1 - b) * hopSize + fftSize));
+            src.read (block.data(), (juce::int64) b * hopSize, (int) block.size());
+            for (int f = b; f < e; ++f) { const float v = analyseFrame (st, block.data(), (f - b) * hopSize); if (f >= f0) out[f - f0] = v; }
+        }
+    }
+    void computeNovelty (const AnalysisSource& src, std::vector<float>& novelty) {
+        novelty.clear();
+        if (src.data == nullptr && ! src.read) return;
+        // Onsets are int sample indices: analyse at most the first INT_MAX samples
+        const int frames = numFrames ((int) juce::jmin<juce::int64> (src.numSamples, std::numeric_limits<int>::max()), fftSize, hopSize);
+        if (frames <= 0) return;
+        novelty.resize ((size_t) frames);
+        // Long files: split into chunks processed in parallel, each worker with its own FFT.
+        // The first chunk runs on the calling thread.
+        const int maxChunks = juce::jmax (1, juce::SystemStats::getNumCpus());
+        const int numChunks = juce::jlimit (1, maxChunks, frames / minFramesPerChunk);
+        const int perChunk = (frames + numChunks - 1) / numChunks;
+        if (numChunks > 1 && workers == nullptr)
+            workers = std::make_unique<juce::ThreadPool> (juce::jmax (1, maxChunks - 1));
+        std::atomic<int> remaining { numChunks - 1 }; juce::WaitableEvent done;
+        for (int c = 1; c < numChunks; ++c) {
+            const int f0 = c * perChunk, f1 = juce::jmin (frames, f0 + perChunk);
+            workers->addJob ([this, &src, &novelty, &remaining, &done, f0, f1] {
+                if (f0 < f1) computeRange (src, f0, f1, novelty.data() + f0);
+                if (remaining.fetch_sub (1) == 1) done.signal();
+            });
         }
+        computeRange (src, 0, juce::jmin (frames, perChunk), novelty.data());
+        if (numChunks > 1) done.wait();
     }
+    static constexpr int minFramesPerChunk = 2048; // ~24 s at 44.1 kHz, hop 512
+    static constexpr int framesPerRead = 256;
     double sr = 44100.0; int order = 12, fftSize = 4096, hopSize = 512; float thresholdScale { 1.2f }; int localWindow { 16 };
-    juce::AudioBuffer<float> window, tempBlock;
-    std::unique_ptr<juce::dsp::FFT> fft; std::vector<float> mag, prevMag;
+    ThresholdMode thresholdMode { ThresholdMode::mean };
+    juce::AudioBuffer<float> window;
+    std::unique_ptr<juce::ThreadPool> workers;
 };
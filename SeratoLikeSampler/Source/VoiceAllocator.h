@@ -0,0 +1,125 @@
+#pragma once
+#include <juce_core/juce_core.h>
+#include <array>
+#include <vector>
+
+// Which sounding voice a note-on takes over when the polyphony is used up. sameNote also
+// fades earlier voices on the same note first (one voice per note; fast repeats don't pile up).
+enum class VoiceStealPolicy { oldest, quietest, sameNote };
+
+// Voice bookkeeping for the audio thread. Voices are indices into the caller's bank; each
+// one is free, sounding (oldest first) or fading out after a steal or choke. Free voices sit
+// on a stack and sounding ones are also linked per MIDI note and per choke group, so
+// note-on, note-off and choke only touch the voices they affect; the quietest-voice steal
+// is the one path that scans (the sounding voices). Only prepare() allocates.
+template <int numGroups>
+class VoiceAllocator {
+public:
+    static constexpr int none = -1;
+    // Sizes the bookkeeping for a bank of numVoices, all free. Not on the audio thread.
+    void prepare (int numVoices, int polyphonyToUse) {
+        nodes.resize ((size_t) juce::jmax (1, numVoices)); freeList.resize (nodes.size());
+        reset (polyphonyToUse);
+    }
+    // Frees every voice. At most polyphony voices sound at once; the rest of the bank
+    // carries fade-outs.
+    void reset (int polyphonyToUse) {
+        const int capacity = (int) nodes.size();
+        polyphony = juce::jlimit (1, juce::jmax (1, capacity), polyphonyToUse);
+        numFree = 0;
+        for (int v = capacity; --v >= 0;) { nodes[(size_t) v] = {}; freeList[(size_t) numFree++] = v; }
+        sounding = {}; fading = {}; byNote.fill ({}); byGroup.fill ({});
+    }
+    // Voice for a new note. If polyphony voices already sound, one is stolen: victims move
+    // to the fading list and are passed to fade(). When every spare voice is busy fading,
+    // the oldest fade is cut short and reused. Group 0 is no choke group.
+    template <typename Level, typename Fade>
+    int noteOn (int note, int group, VoiceStealPolicy policy, Level&& level, Fade&& fade) {
+        note = juce::jlimit (0, 127, note); group = juce::jlimit (0, numGroups - 1, group);
+        if (policy == VoiceStealPolicy::sameNote)
+            while (byNote[(size_t) note].head != none) startFade (byNote[(size_t) note].head, fade);
+        if (sounding.size >= polyphony) startFade (victim (policy, level), fade);
+        int v = none;
+        if (numFree > 0) v = freeList[(size_t) --numFree];
+        else { v = fading.head; unlink<&Node::age> (fading, v); }
+        auto& n = nodes[(size_t) v];
+        n.note = note; n.group = group; n.state = State::sounding;
+        append<&Node::age> (sounding, v);
+        append<&Node::sameNote> (byNote[(size_t) note], v);
+        append<&Node::sameGroup> (byGroup[(size_t) group], v);
+        return v;
+    }
+    // Fades every sounding voice in the group (no-op for group 0).
+    template <typename Fade>
+    void choke (int group, Fade&& fade) {
+        if (group <= 0 || group >= numGroups) return;
+        while (byGroup[(size_t) group].head != none) startFade (byGroup[(size_t) group].head, fade);
+    }
+    // Calls fn for each sounding voice playing the note.
+    template <typename Fn>
+    void forEachOnNote (int note, Fn&& fn) const {
+        if (note < 0 || note > 127) return;
+        for (int v = byNote[(size_t) note].head; v != none; v = nodes[(size_t) v].sameNote.next) fn (v);
+    }
+    // Calls fn for every sounding and fading voice.
+    template <typename Fn>
+    void forEachPlaying (Fn&& fn) const {
+        for (auto* list : { &sounding, &fading })
+            for (int v = list->head; v != none; v = nodes[(size_t) v].age.next) fn (v);
+    }
+    // The voice has finished: back to the free stack.
+    void release (int v) {
+        auto& n = nodes[(size_t) v];
+        if (n.state == State::sounding)    unlinkSounding (v);
+        else if (n.state == State::fading) unlink<&Node::age> (fading, v);
+        else return;
+        n.state = State::free;
+        freeList[(size_t) numFree++] = v;
+    }
+    int getNumSounding() const { return sounding.size; }
+    int getNumPlaying() const { return sounding.size + fading.size; }
+private:
+    enum class State { free, sounding, fading };
+    struct Link { int prev { none }, next { none }; };
+    struct Node { Link age, sameNote, sameGroup; int note { 0 }, group { 0 }; State state { State::free }; };
+    struct List { int head { none }, tail { none }, size { 0 }; };
+    template <Link Node::* link>
+    void append (List& l, int v) {
+        auto& n = nodes[(size_t) v].*link;
+        n.prev = l.tail; n.next = none;
+        if (l.tail != none) (nodes[(size_t) l.tail].*link).next = v; else l.head = v;
+        l.tail = v; ++l.size;
+    }
+    template <Link Node::* link>
+    void unlink (List& l, int v) {
+        auto& n = nodes[(size_t) v].*link;
+        if (n.prev != none) (nodes[(size_t) n.prev].*link).next = n.next; else l.head = n.next;
+        if (n.next != none) (nodes[(size_t) n.next].*link).prev = n.prev; else l.tail = n.prev;
+        n = {}; --l.size;
+    }
+    void unlinkSounding (int v) {
+        const auto& n = nodes[(size_t) v];
+        unlink<&Node::age> (sounding, v);
+        unlink<&Node::sameNote> (byNote[(size_t) n.note], v);
+        unlink<&Node::sameGroup> (byGroup[(size_t) n.group], v);
+    }
+    template <typename Fade>
+    void startFade (int v, Fade&& fade) {
+        unlinkSounding (v);
+        append<&Node::age> (fading, v); nodes[(size_t) v].state = State::fading;
+        fade (v);
+    }
+    template <typename Level>
+    int victim (VoiceStealPolicy policy, Level&& level) const {
+        if (policy != VoiceStealPolicy::quietest) return sounding.head;
+        int best = sounding.head; float bestLevel = level (best);
+        for (int v = nodes[(size_t) best].age.next; v != none; v = nodes[(size_t) v].age.next) {
+            const float l = level (v);
+            if (l < bestLevel) { best = v; bestLevel = l; }
+        }
+        return best;
+    }
+    std::vector<Node> nodes; std::vector<int> freeList; int numFree { 0 };
+    List sounding, fading; std::array<List, 128> byNote; std::array<List, numGroups> byGroup;
+    int polyphony { 1 };
+};
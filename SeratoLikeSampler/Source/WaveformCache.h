@@ -1,30 +1,148 @@
-
 #pragma once
 #include <juce_audio_basics/juce_audio_basics.h>
+#include <array>
+#include <atomic>
+#include <memory>
 #include <vector>
+// Min/max overview as a pyramid of levels (64, 256, 1024, 4096, 16384 samples per bin),
+// so a view of any width reads about one to four bins per pixel. Built on the loader
+// thread while the UI draws it: reset() sizes every level for the final length up front
+// and append() fills them in order, so the UI can draw the part already decoded.
 class WaveformCache {
 public:
-    void build (const juce::AudioBuffer<float>& buffer, int samplesPerBin = 512) {
-        bins.clear();
-        if (buffer.getNumSamples() == 0) return;
-        const int numBins = juce::jmax (1, buffer.getNumSamples() / samplesPerBin);
-        bins.resize (numBins, {0.f, 0.f});
-        for (int i = 0; i < numBins; ++i) {
-            const int start = i * samplesPerBin;
-            const int end = juce::jmin (buffer.getNumSamples(), start + samplesPerBin);
-            float mn =  1e9f, mx = -1e9f;
-            for (int s = start; s < end; ++s) {
-                float v = 0.f;
-                for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
-                    v += std::abs (buffer.getSample (ch, s));
-                v /= (float) buffer.getNumChannels();
-                mn = std::min (mn, v);
-                mx = std::max (mx, v);
-            }
-            bins[i] = { mn, mx };
+    using Bin = std::pair<float,float>;
+    static constexpr int numLevels = 5;
+    static constexpr int binSizeOf (int level) { return 64 << (2 * level); }
+    // UI-side view of one level: every bin of the finished level, of which the first
+    // numReady() are filled. Keeps its storage alive across a concurrent reset.
+    struct View {
+        std::shared_ptr<const std::vector<Bin>> bins; int ready { 0 }; int binSize { 1 };
+        size_t size() const { return bins != nullptr ? bins->size() : 0; }
+        bool empty() const { return size() == 0; }
+        int numReady() const { return ready; }
+        const Bin& operator[] (size_t i) const { return (*bins)[i]; }
+    };
+    WaveformCache() { reset (0); }
+    void build (const juce::AudioBuffer<float>& buffer) {
+        reset (buffer.getNumSamples()); append (buffer, 0, buffer.getNumSamples()); finish();
+    }
+    // Incremental build for audio that arrives in blocks: reset with the final length,
+    // append in order, finish. Levels that would exceed maxBinsPerLevel are skipped
+    // (very long files start at a coarser level).
+    void reset (juce::int64 totalSamples) {
+        const int first = firstLevelFor (totalSamples);
+        firstLevel.store (first); restored = false;
+        for (int l = 0; l < numLevels; ++l) {
+            auto& lv = levels[(size_t) l];
+            lv.write = std::make_shared<std::vector<Bin>> ((size_t) binCount (l, first, totalSamples), Bin { 0.0f, 0.0f });
+            lv.filled = 0; lv.acc = {};
+            lv.ready.store (0);
+            std::atomic_store (&lv.bins, std::shared_ptr<const std::vector<Bin>> (lv.write));
+        }
+    }
+    // Levels of a finished build of the same audio (AnalysisCache). Refused, leaving the
+    // cache as it was, unless they are the levels reset (totalSamples) would size. Restored
+    // levels are complete: append() and finish() leave them alone until the next reset().
+    bool restore (juce::int64 totalSamples, int first, std::array<std::vector<Bin>, numLevels> bins) {
+        if (first != firstLevelFor (totalSamples)) return false;
+        for (int l = 0; l < numLevels; ++l)
+            if ((juce::int64) bins[(size_t) l].size() != binCount (l, first, totalSamples)) return false;
+        firstLevel.store (first); restored = true;
+        for (int l = 0; l < numLevels; ++l) {
+            auto& lv = levels[(size_t) l];
+            lv.write = std::make_shared<std::vector<Bin>> (std::move (bins[(size_t) l]));
+            lv.filled = (int) lv.write->size(); lv.acc = {};
+            std::atomic_store (&lv.bins, std::shared_ptr<const std::vector<Bin>> (lv.write));
+            lv.ready.store (lv.filled);
+        }
+        return true;
+    }
+    bool isRestored() const { return restored; }
+    int getFirstLevel() const { return firstLevel.load(); }
+    void append (const juce::AudioBuffer<float>& block, int start, int num) {
+        const int chans = block.getNumChannels();
+        if (chans == 0 || restored) return;
+        const int first = firstLevel.load();
+        auto& base = levels[(size_t) first];
+        const int baseSize = binSizeOf (first);
+        for (int s = start; s < start + num; ++s) {
+            float v = 0.f;
+            for (int ch = 0; ch < chans; ++ch)
+                v += std::abs (block.getSample (ch, s));
+            base.acc.add (v / (float) chans, v / (float) chans, 1);
+            if (base.acc.count == baseSize) completeBin (first);
+        }
+        for (auto& lv : levels) lv.ready.store (lv.filled);
+    }
+    // A trailing partial bin is dropped unless it is the only one in its level.
+    void finish() {
+        if (restored) return;
+        Acc carry;
+        for (int l = firstLevel.load(); l < numLevels; ++l) {
+            auto& lv = levels[(size_t) l];
+            lv.acc.merge (carry); carry = lv.acc;
+            if (lv.filled == 0 && lv.acc.count > 0) push (lv);
+            lv.acc = {};
+            lv.ready.store (lv.filled);
         }
     }
-    const std::vector<std::pair<float,float>>& get() const { return bins; }
+    // Safe from any thread.
+    View get (int level) const {
+        level = juce::jlimit (0, numLevels - 1, level);
+        const auto& lv = levels[(size_t) level];
+        View v { std::atomic_load (&lv.bins), 0, binSizeOf (level) };
+        v.ready = juce::jmin (lv.ready.load(), (int) v.size()); // a reset may land between the two loads
+        return v;
+    }
+    // Coarsest built level with at most samplesPerPixel samples per bin (the finest built
+    // level when zoomed in further than that).
+    int levelFor (double samplesPerPixel) const {
+        int level = firstLevel.load();
+        while (level + 1 < numLevels && binSizeOf (level + 1) <= samplesPerPixel) ++level;
+        return level;
+    }
+    // Min/max of the channel-averaged magnitude over [start, start+num), the same measure
+    // the bins hold. For drawing below the finest level.
+    static Bin measure (const juce::AudioBuffer<float>& block, int start, int num) {
+        Acc a; const int chans = block.getNumChannels();
+        for (int s = start; s < start + num && chans > 0; ++s) {
+            float v = 0.f;
+            for (int ch = 0; ch < chans; ++ch) v += std::abs (block.getSample (ch, s));
+            a.add (v / (float) chans, v / (float) chans, 1);
+        }
+        return a.count > 0 ? Bin { a.mn, a.mx } : Bin { 0.0f, 0.0f };
+    }
 private:
-    std::vector<std::pair<float,float>> bins;
+    struct Acc {
+        float mn { 1e9f }, mx { -1e9f }; int count { 0 };
+        void add (float lo, float hi, int n) { mn = std::min (mn, lo); mx = std::max (mx, hi); count += n; }
+        void merge (const Acc& o) { if (o.count > 0) add (o.mn, o.mx, o.count); }
+    };
+    struct Level {
+        std::shared_ptr<std::vector<Bin>> write; std::shared_ptr<const std::vector<Bin>> bins;
+        std::atomic<int> ready { 0 }; int filled { 0 }; Acc acc;
+    };
+    static void push (Level& lv) { if (lv.filled < (int) lv.write->size()) (*lv.write)[(size_t) lv.filled++] = { lv.acc.mn, lv.acc.mx }; }
+    // Level l's accumulator holds a full bin: store it and fold it into the next level up.
+    void completeBin (int l) {
+        for (;;) {
+            auto& lv = levels[(size_t) l];
+            push (lv);
+            const Acc done = lv.acc; lv.acc = {};
+            if (++l == numLevels) return;
+            auto& up = levels[(size_t) l];
+            up.acc.merge (done);
+            if (up.acc.count < binSizeOf (l)) return;
+        }
+    }
+    static int firstLevelFor (juce::int64 totalSamples) {
+        int first = 0;
+        while (first < numLevels - 1 && totalSamples / binSizeOf (first) > maxBinsPerLevel) ++first;
+        return first;
+    }
+    static juce::int64 binCount (int level, int first, juce::int64 totalSamples) {
+        return level >= first && totalSamples > 0 ? juce::jmax<juce::int64> (1, totalSamples / binSizeOf (level)) : 0;
+    }
+    static constexpr juce::int64 maxBinsPerLevel = (juce::int64) 1 << 22; // 32 MB per level
+    std::array<Level, numLevels> levels; std::atomic<int> firstLevel { 0 }; bool restored { false }; // loader thread
 };